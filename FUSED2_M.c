@@ -0,0 +1,119 @@
+/* FUSED2_M.cmex */
+
+/* MATLAB USAGE: [out1,out2,...]=FUSED2_M(matrixIn,windowSize,nlook,damp,
+ *							outputs)
+ *		 [out1,out2,...]=FUSED2_M(matrixIn,windowSize,nlook,damp,
+ *						outputs,name,value,...)
+ *
+ * the local mean, median, Lee and enhanced Lee filters of AV2_M, MED2_M,
+ * LEE2_M and ELEE2_M with the same windows, computed together: the input
+ * is read and padded once, and the local means and variances are shared by
+ * the mean and both Lee filters, so several results cost little more than
+ * one. outputs lists the results wanted in the order they are returned,
+ * separated by commas or spaces: 'mean', 'median', 'lee' and 'elee'
+ * (default all four). The mean matches AV2_M to rounding, the others are
+ * those of MED2_M, LEE2_M and ELEE2_M (method 'moments').
+ *
+ * 'method':	of the median, as for MED2_M
+ * 'threads', 'border', 'class', 'mask', 'persistent':	as for the
+ *		other filters, FUSED2_M('release') freeing what 'persistent'
+ *		kept
+ *
+ * windowSize is the side of square windows, or [rows cols] of rectangular
+ * ones.
+ * matrixIn may be double, single, uint8, uint16 or int16, and a stack of
+ * matrices (M x N x K ...), each frame being filtered on its own */
+
+#include <limits.h>
+#include <string.h>
+#include "mex.h"
+#include "filters.h"
+#include "options.h"
+
+/* mex 'main' function */
+void mexFunction(	int nlhs, 
+			mxArray *plhs[], 
+			int nrhs, 
+			const mxArray *prhs[])	{
+				
+	int ws, nlook, damp;		/* window size and Lee parameters */
+	filter_options opts;		/* optional name/value pairs */
+	int out_class;			/* FILTER_ class of the outputs */
+	filter_data data;		/* the arrays as filters.h takes them */
+	filter_stats stats;		/* timings, see FILTER_STATS */
+	filter_stats *timed;		/* &stats, or null when not wanted */
+	double since;
+	void *outs[FUSED_OUTPUTS];	/* each output, null if not wanted */
+	int which[FUSED_OUTPUTS];	/* FUSED_ output of each plhs */
+	char list[64], *name;
+	int k, n, first;
+
+	timed=get_stats(&stats,&since);
+
+	/* FUSED2_M('release') frees what 'persistent' calls kept */
+	if(release_call(nrhs,prhs))
+		return;
+
+	/* checking number of inputs */
+	if(nrhs<4)
+		mexErrMsgTxt("Must have at least four input arguments");
+	
+	/* getting arguments three and four (looks and damping) */
+	nlook=get_int(prhs[2],1,"nlook must be a positive whole number");
+	damp=get_int(prhs[3],INT_MIN,"damp must be a whole number");
+
+	/* getting argument five (outputs), if it is not an option name */
+	strcpy(list,"mean,median,lee,elee");
+	first=4;
+	if(nrhs%2==1){
+		if(!mxIsChar(prhs[4]))
+			mexErrMsgTxt("outputs must be a string");
+		mxGetString(prhs[4],list,sizeof(list));
+		first=5;
+	}
+	n=0;
+	for(name=strtok(list,", "); name; name=strtok(0,", ")){
+		if(n==FUSED_OUTPUTS)
+			mexErrMsgTxt("at most four outputs");
+		if(!strcmp(name,"mean"))
+			which[n]=FUSED_MEAN;
+		else if(!strcmp(name,"median"))
+			which[n]=FUSED_MEDIAN;
+		else if(!strcmp(name,"lee"))
+			which[n]=FUSED_LEE;
+		else if(!strcmp(name,"elee"))
+			which[n]=FUSED_ELEE;
+		else
+			mexErrMsgTxt("outputs must be 'mean', 'median', 'lee' or 'elee'");
+		for(k=0; k<n; k++)
+			if(which[k]==which[n])
+				mexErrMsgTxt("outputs must not be listed twice");
+		n++;
+	}
+	if(nlhs>n || n==0)
+		mexErrMsgTxt("Must have one output argument per output listed");
+	
+	/* getting the optional name/value pairs */
+	get_options(&opts,&out_class,first,nrhs,prhs);
+	no_async();
+
+	/* getting argument two (window size), a side or [rows cols] */
+	ws=get_window(&opts,prhs[1]);
+	
+	/* creating the outputs asked for, of the input's shape, and filtering
+	 * into them (see fused.c); listed outputs past nlhs are not made */
+	if(nlhs<1)
+		nlhs=1;
+	for(k=0; k<FUSED_OUTPUTS; k++)
+		outs[k]=0;
+	for(k=0; k<nlhs; k++){
+		get_data(&data,&plhs[k],prhs[0],out_class);
+		outs[which[k]]=data.out;
+	}
+	args_read(timed,&since);
+	opts.stats=timed;
+	check_status(fused_filter(&data,outs,ws,nlook,damp,&opts));
+	
+	put_stats("FUSED2_M",timed);
+	end_call();		/* unlocks, unless 'persistent' */
+}
@@ -1,14 +1,61 @@
 /* MED2_M.cmex */
 
-/* MATLAB USAGE: matrixOut=MED2_M(matrixIn,windowSize) */
+/* MATLAB USAGE: [matrixOut,passes]=MED2_M(matrixIn,windowSize)
+ *		 [matrixOut,passes]=MED2_M(matrixIn,windowSize,name,value,...)
+ *
+ * 'method':	'auto'	 'network' for 3x3 and 5x5 windows, and 7x7 when
+ *			 'hist' cannot run, else 'hist' when the input allows
+ *			 it, else 'sorted' for windows of SORTED_MIN_WS squared
+ *			 taps and up, else 'direct' (default)
+ *		'hist'	 sliding histograms, per pixel cost independent of ws,
+ *			 for integer valued inputs spanning <= HIST_MAX_BINS values
+ *		'sorted' window kept ordered in two heaps, one column of ws
+ *			 values replaced per pixel, O(ws log ws) per pixel (for
+ *			 [rows cols], cols values and O(cols log(rows cols)))
+ *		'network' branch-free sorting networks for 3x3, 5x5 and
+ *			 7x7 windows, on several pixels at once and sharing
+ *			 each sorted window column between the windows
+ *			 holding it; other windows run 'direct'
+ *		'direct' gathers and quickselects every window
+ * 'threads':	worker threads (default: FILTER_THREADS, else one per core)
+ * 'border':	'mirror' (default), 'replicate', 'wrap', 'constant' (zero) or
+ *		a number to pad with
+ * 'class':	of the output, 'same' as the input (default), 'double',
+ *		'single', 'uint8', 'uint16' or 'int16'
+ * 'mask':	logical matrix of matrixIn's rows and columns: only the
+ *		pixels it selects are filtered, the others copied from
+ *		matrixIn (the same in every frame), so that a small area
+ *		costs little (default: every pixel)
+ * 'kept':	the output of an earlier call with the same arguments, kept
+ *		wherever no window reads a pixel changed since and filtered
+ *		again elsewhere, so that a video frame differing from the
+ *		last in small areas costs little. What changed is given by
+ * 'previous':	the earlier matrixIn, compared with matrixIn, or
+ * 'changed':	rows [row0 row1 col0 col1] of the rectangles holding every
+ *		change (in every frame)
+ * 'iterations':	passes, each filtering the result of the one before as a
+ *		new call would (default 1), passes returning how many ran
+ * 'tolerance':	stops after the first pass changing values by less than
+ *		this on average (default 0, never)
+ * 'persistent':	true keeps the worker threads, scratch memory and the
+ *		tables of the last few matrix sizes for later calls, which
+ *		then set up nothing again on matrices alike; the mex file
+ *		stays locked until MED2_M('release') frees them (default false)
+ * 'async':	true returns a handle at once instead, the filtering of a
+ *		copy of matrixIn going on in the background (default false):
+ *		MED2_M('poll',h) is 1 once it has finished, MED2_M('wait',h)
+ *		waits for and returns [matrixOut,passes] (once), and
+ *		MED2_M('cancel',h) stops and drops it. Not with 'persistent',
+ *		'previous', 'kept' or 'changed'
+ *
+ * windowSize is the side of square windows, or [rows cols] of rectangular
+ * ones.
+ * matrixIn may be double, single, uint8, uint16 or int16, and a stack of
+ * matrices (M x N x K ...), each frame being filtered on its own */
 
-#include <math.h>
 #include "mex.h"
-
-/* prototypes */
-void filter(double**, double**, int, int, int);
-double fill(double**,int,int,int,int,int,int);
-double median(double*,int);
+#include "filters.h"
+#include "options.h"
 
 /* mex 'main' function */
 void mexFunction(	int nlhs, 
@@ -16,176 +63,54 @@ void mexFunction(	int nlhs,
 			int nrhs, 
 			const mxArray *prhs[])	{
 				
-	int no_rows, no_cols;	/* number of rows and columns (argument 1) */
-	int r,c;		/* for loop variables */
-	int trv;		/* traverse mex kernelays */
-	int size_element;	/* size of kernelay element (for malloc) */
-	double *in_handle, *out_handle;	/* copying mex 'fortran' kernelays */ 
-	double *in_kernelay, *out_kernelay;	/* dynamic kernelays (1-D) */
-	double **in, **out;		/* dynamic kernelays (quasi 2-D) */
-	char *err_msg;			/* an error message string */
 	int ws;				/* window size */
+	filter_options opts;		/* optional name/value pairs */
+	int out_class;			/* FILTER_ class of the output */
+	filter_data data;		/* the arrays as filters.h takes them */
+	filter_stats stats;		/* timings, see FILTER_STATS */
+	filter_stats *timed;		/* &stats, or null when not wanted */
+	double since;
+	int passes;			/* filterings done */
 
-	/* checking number of inputs */
-	if(nrhs !=2)
-		mexErrMsgTxt("Must have three input arguments");
-	if(nlhs !=1)
-		mexErrMsgTxt("Must have one output argument");
-		
-	/* preventing sparse, complex and string matrices */
-	if( mxIsComplex(prhs[0])||!(mxIsClass(prhs[0],"double"))
-	    || mxIsClass(prhs[0],"sparse") || mxIsChar(prhs[0]) ){
-		err_msg="input must be real, double, full and non-string";
-		mexErrMsgTxt(err_msg);
-	}
-								
-	/* getting the number of rows and columns from input matrix */
-	no_rows=mxGetM(prhs[0]);
-	no_cols=mxGetN(prhs[0]);
-	
-	/* getting argument two (window size) */
-	ws=(int)mxGetScalar(prhs[1]);
-		
-	/* creating an output kernelay, giving it a handle */
-	plhs[0]=mxCreateDoubleMatrix(no_rows,no_cols,mxREAL);
-	out_handle=mxGetPr(plhs[0]);
-	
-	/* creating dynamic 2d kernelays */
-	in_kernelay = (double*) mxMalloc (no_rows*no_cols*sizeof(double));
-	in = (double**) mxMalloc (no_rows*sizeof(double*));
-	out_kernelay = (double*) mxMalloc (no_rows*no_cols*sizeof(double));
-	out = (double**) mxMalloc (no_rows*sizeof(double*));
-	for(r=0; r<no_rows; r++){
-		in[r]=&(in_kernelay[r*no_cols]);
-		out[r]=&(out_kernelay[r*no_cols]);
-	}
-	
-	/* creating an input kernelay, giving it a handle */
-	in_handle=mxGetPr(prhs[0]);
-	
-	/*************************************************************************
-	** copying 1-d input kernelay into 2-d matrix, note that since MATLAB	**		
-	** was originally written in fortran, it treats kernelays in a manner 	**
-	** similiar to fortran. Thus, in MATLAB, 2-d matrices are stored 	**
-	** as 1-d matrices in the following way:				**
-	**									**
-	** (2-d)                   (1-d)					**
-	** 1 2 3								**
-	** 4 5 6	= 	1 4 2 5 3 6					**
-	*************************************************************************/
-	trv=0;	
-	for(c=0; c<no_cols; c++){
-		for(r=0; r<no_rows; r++)
-			in[r][c]=in_handle[trv++];
-	}
+	timed=get_stats(&stats,&since);
 
-	/* PROCESS THE MATRIX/ARRAY HERE */
-	filter(in,out,no_rows,no_cols,ws);		
-	
-	/* copying the dynamic matrix to the output handle */
-	trv=0;
-	for(c=0; c<no_cols; c++){
-		for(r=0; r<no_rows; r++)
-			out_handle[trv++]=out[r][c];
-	}
+	/* MED2_M('release') frees what 'persistent' calls kept */
+	if(release_call(nrhs,prhs))
+		return;
 
-	/* freeing dynamic memory */
-	mxFree(in[0]); in_kernelay=0;
-	mxFree(in); in=0;
-	mxFree(out[0]); out_kernelay=0;
-	mxFree(out); out=0;
-	
-	mexUnlock();		/* allows for re-compiling */
-}
+	/* MED2_M('poll'|'wait'|'cancel',handle) on an 'async' job */
+	if(job_call("MED2_M",nlhs,plhs,nrhs,prhs))
+		return;
 
-/* perform filtering */
-void filter(double **m_in, double **m_out, int no_rows, int no_cols, int ws){
-	int curRow, curCol;
-	int side, scale;
+	/* checking number of inputs */
+	if(nrhs<2)
+		mexErrMsgTxt("Must have two input arguments");
+	if(nlhs<1 || nlhs>2)
+		mexErrMsgTxt("Must have one or two output arguments");
 	
-	side=ws; 		/* size of kernel side (assumed square) */
-	scale=(int)(side-1)/2;	/* "width" of kernel */
-		
-	/* filling output matrix by first filling kernel values and then
-	 * processing these kernel values */
-	for(curRow=0; curRow<no_rows; curRow++){
-		for(curCol=0; curCol<no_cols; curCol++)		
-			m_out[curRow][curCol]=
-				fill(m_in,curRow,curCol,side,scale,no_rows,no_cols);
-	}
-}
+	/* getting the optional name/value pairs */
+	get_options(&opts,&out_class,2,nrhs,prhs);
 
-/* "fill" kernel */
-double fill(double **m_in,int curRow,int curCol,
-	int side,int scale,int no_rows,int no_cols){
-				
-	int length=side*side;
-	int rPos, cPos, rDiff, cDiff, r, c;
-	double *kernel_kernelay;
-	int retVal;
-		
-	/* creating dynamic 1-D kernelay */
-	kernel_kernelay = (double*) mxMalloc (no_rows*no_cols*sizeof(double));
-		
-	/* filling the kernel_kernelay */
-	for(r=0; r<side; r++){
-	    	rPos=curRow-scale+r;
-	    	for(c=0; c<side; c++){
-			cPos=curCol-scale+c;
-			/* mirror padding */	
-			if(rPos<0)			
-			  	rPos=(sqrt(pow(rPos,2)))-1;
-			if(rPos>=no_rows){
-		   		rDiff=rPos-no_rows;
-		   		rPos=no_rows-rDiff-1;
-			}
-			if(cPos<0)
-		     		cPos=(sqrt(pow(cPos,2)))-1;
-	 		if(cPos>=no_cols){
-		   		cDiff=cPos-no_cols;
-				cPos=no_cols-cDiff-1;
-			}
-			kernel_kernelay[(side*r)+c]=m_in[rPos][cPos];							
-	    	}
+	/* getting argument two (window size), a side or [rows cols] */
+	ws=get_window(&opts,prhs[1]);
+
+	/* with 'async', the handle of a job filtering a copy instead */
+	if(submit_job(filter_run,"med2",&plhs[0],prhs[0],out_class,ws,0,0,&opts,
+								timed)){
+		end_call();
+		return;
 	}
-				
-	/* processing the values within the kernel */	
-	retVal = median(kernel_kernelay,length);
-	mxFree(kernel_kernelay); kernel_kernelay=0;
-	return retVal;
-}
 	
-#define ELEM_SWAP(a,b) { double temp =(a); (a)=(b); (b)=temp; }
-
-/* "process" the kernel values with quickselect routine */
-double median(double* kernel, int length){
-        int low, high;
-        int median;
-        int middle, ll, hh;
-
-        low=0; high=length-1; median=((low+high)/2);
-        for(;;) {
-                if(high <= low) return kernel[median];
-                if(high == low+1) {
-                        if(kernel[low] > kernel[high])
-                                ELEM_SWAP(kernel[low],kernel[high]);
-                        return kernel[median];
-                }
-                middle = (low+high)/2;
-                if(kernel[middle] > kernel[high]) ELEM_SWAP(kernel[middle],kernel[high]);
-                if(kernel[low] > kernel[high]) ELEM_SWAP(kernel[low],kernel[high]);
-		if(kernel[middle] > kernel[low]) ELEM_SWAP(kernel[middle],kernel[low]);
-                ELEM_SWAP(kernel[middle],kernel[low+1]);
-                ll=low+1;
-                hh=high;
-                for(;;) {
-                        do ll++; while (kernel[low] > kernel[ll]);
-                        do hh--; while (kernel[hh] > kernel[low]);
-                        if(hh < ll) break;
-                        ELEM_SWAP(kernel[ll],kernel[hh]);
-                }
-                ELEM_SWAP(kernel[low],kernel[hh]);
-                if(hh <= median) low=ll;
-                if(hh >= median) high=hh-1;
-        }
+	/* creating an output array of the input's shape and filtering into
+	 * it (see med2.c) */
+	get_data(&data,&plhs[0],prhs[0],out_class);
+	opts.passes=&passes;
+	args_read(timed,&since);
+	opts.stats=timed;
+	check_status(med2_filter(&data,ws,&opts));
+	if(nlhs==2)
+		plhs[1]=mxCreateDoubleScalar(passes);
+	
+	put_stats("MED2_M",timed);
+	end_call();		/* unlocks, unless 'persistent' */
 }
@@ -0,0 +1,72 @@
+/* arena.c */
+
+#include <stdlib.h>
+#include "arena.h"
+
+/* n arenas of size bytes each, null when memory runs out */
+arena *arena_create(int n, size_t size){
+	arena *a;
+	int i;
+	
+	a=(arena*)malloc(n*sizeof(arena));
+	if(!a)
+		return 0;
+	for(i=0; i<n; i++){
+		a[i].block=malloc(ARENA_BYTES(size)+ARENA_ALIGN);
+		if(!a[i].block){
+			arena_destroy(a,i);
+			return 0;
+		}
+		a[i].base=(char*)ARENA_BYTES((size_t)a[i].block);
+		a[i].size=ARENA_BYTES(size);
+		a[i].used=0;
+		a[i].spill=0;
+		a[i].failed=0;
+	}
+	return a;
+}
+
+void arena_destroy(arena *a, int n){
+	int i;
+	
+	for(i=0; i<n; i++){
+		arena_reset(&a[i]);
+		free(a[i].block);
+	}
+	free(a);
+}
+
+/* a block of n bytes, valid until the next arena_reset(). Should the sizes
+ * worked out up front fall short, the block comes from malloc instead (safe
+ * on worker threads) and is freed by arena_reset(); should that fail, the
+ * tile is given up (see arena.h) */
+void *arena_alloc(arena *a, size_t n){
+	void **spill;
+	char *p;
+	
+	if(a->used+ARENA_BYTES(n)<=a->size){
+		p=a->base+a->used;
+		a->used+=ARENA_BYTES(n);
+		return p;
+	}
+	spill=(void**)malloc(ARENA_BYTES(sizeof(void*))+n);
+	if(!spill){
+		a->failed=1;
+		longjmp(a->bail,1);
+	}
+	*spill=a->spill;
+	a->spill=spill;
+	return (char*)spill+ARENA_BYTES(sizeof(void*));
+}
+
+/* release every block handed out */
+void arena_reset(arena *a){
+	void **spill;
+	
+	while(a->spill){
+		spill=(void**)a->spill;
+		a->spill=*spill;
+		free(spill);
+	}
+	a->used=0;
+}
@@ -0,0 +1,34 @@
+/* arena.h */
+
+/* per call scratch memory: one arena per worker, sized up front on the
+ * calling thread and handed out by bumping a pointer, so the filter loops
+ * make no heap allocations. Should an arena run out and malloc() fail too,
+ * arena_alloc() sets failed and longjmp()s to bail, which a tile job sets
+ * with setjmp() before its first arena_alloc() */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <setjmp.h>
+#include <stddef.h>
+
+#define ARENA_ALIGN	64	/* every block starts on a cache line */
+
+/* bytes arena_alloc() takes for a block of n bytes */
+#define ARENA_BYTES(n)	(((size_t)(n)+ARENA_ALIGN-1)/ARENA_ALIGN*ARENA_ALIGN)
+
+typedef struct {
+	char *base;		/* aligned start of the arena */
+	size_t size, used;
+	void *block;		/* allocation behind base */
+	void *spill;		/* blocks malloc'ed once the arena ran out */
+	int failed;		/* a malloc() of arena_alloc() failed */
+	jmp_buf bail;		/* where arena_alloc() then goes */
+} arena;
+
+arena *arena_create(int, size_t);
+void arena_destroy(arena*, int);
+void *arena_alloc(arena*, size_t);
+void arena_reset(arena*);
+
+#endif
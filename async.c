@@ -0,0 +1,175 @@
+/* async.c */
+
+/* jobs of filter_submit() (see filters.h). Each runs its filter on a
+ * thread of its own, which marks it done under the job's lock and wakes
+ * whoever waits for it. Cancelling sets the flag the job's workers check
+ * before each tile (filter_options.cancel), so a job stops within a tile of
+ * being cancelled.
+ *
+ * The jobs running at once share parallel_threads(0) workers: each takes
+ * what it asks for of those left (waiting while none are) and gives them
+ * back when done, so several jobs do not start a set of workers per core
+ * each. Tiling not depending on the thread count, the results are the
+ * same */
+
+#include <stdlib.h>
+#include <string.h>
+#include "filters.h"
+#include "parallel.h"
+#include "threads.h"
+
+struct filter_job {
+	filter_fn run;
+	char name[8];
+	filter_data d;
+	int ws, nlook, damp;
+	filter_options opts;
+	volatile int cancel;
+	lock_t lock;
+	cond_t finished;
+	int done, rc;			/* under lock */
+	thread_t thread;
+	int started;			/* thread to join */
+};
+
+/* workers taken by the jobs running */
+static static_lock_t budget_lock=STATIC_LOCK_INIT;
+static cond_t budget_freed=COND_STATIC_INIT;
+static int workers_taken;
+
+/* prototypes */
+static void run_job(filter_job*);
+static int take_workers(filter_job*);
+static void give_workers(int);
+static THREAD_RESULT job_main(thread_arg);
+
+/* start run(name,d,ws,nlook,damp,opts) on a thread of its own, setting
+ * *job to it (null on failure). Returns FILTER_OK, or FILTER_ERR_MEMORY
+ * (FILTER_ERR_FILTER for a name too long to be a filter's). When no thread
+ * can be had the job runs before this returns */
+int filter_submit(filter_job **job, filter_fn run, const char *name,
+		const filter_data *d, int ws, int nlook, int damp,
+		const filter_options *opts){
+	filter_job *j;
+
+	*job=0;
+	if(strlen(name)>=sizeof(j->name))
+		return FILTER_ERR_FILTER;
+	j=(filter_job*)calloc(1,sizeof(filter_job));
+	if(!j)
+		return FILTER_ERR_MEMORY;
+	j->run=run;
+	strcpy(j->name,name);
+	j->d=*d;
+	j->ws=ws;
+	j->nlook=nlook;
+	j->damp=damp;
+	if(opts)
+		j->opts=*opts;
+	else
+		filter_defaults(&j->opts);
+	j->opts.cancel=&j->cancel;
+	LOCK_INIT(&j->lock);
+	COND_INIT(&j->finished);
+	j->started=THREAD_START(&j->thread,job_main,j);
+	if(!j->started)
+		run_job(j);
+	*job=j;
+	return FILTER_OK;
+}
+
+/* 1 when job has finished (filter_wait() then returning at once), else 0 */
+int filter_poll(filter_job *job){
+	int done;
+
+	LOCK(&job->lock);
+	done=job->done;
+	UNLOCK(&job->lock);
+	return done;
+}
+
+/* wait for job to finish, returning its FILTER_ code */
+int filter_wait(filter_job *job){
+	int rc;
+
+	LOCK(&job->lock);
+	while(!job->done)
+		WAIT(&job->finished,&job->lock);
+	rc=job->rc;
+	UNLOCK(&job->lock);
+	return rc;
+}
+
+/* have job stop at the next tile of each worker, returning
+ * FILTER_ERR_CANCELLED (unless it has finished already) */
+void filter_cancel(filter_job *job){
+	STATIC_LOCK(&budget_lock);	/* should it wait for workers */
+	job->cancel=1;
+	WAKE_ALL(&budget_freed);
+	STATIC_UNLOCK(&budget_lock);
+}
+
+/* wait for job to finish and free it; nothing for null */
+void filter_job_free(filter_job *job){
+	if(!job)
+		return;
+	filter_wait(job);
+	if(job->started){
+		THREAD_JOIN(job->thread);
+	}
+	COND_FREE(&job->finished);
+	LOCK_FREE(&job->lock);
+	free(job);
+}
+
+/* run job on the workers it can take and mark it done */
+static void run_job(filter_job *job){
+	int rc, n;
+
+	n=take_workers(job);
+	if(n>0){
+		job->opts.threads=n;
+		rc=job->run(job->name,&job->d,job->ws,job->nlook,job->damp,
+								&job->opts);
+		give_workers(n);
+	}
+	else
+		rc=FILTER_ERR_CANCELLED;
+	LOCK(&job->lock);
+	job->rc=rc;
+	job->done=1;
+	WAKE_ALL(&job->finished);
+	UNLOCK(&job->lock);
+}
+
+/* as many of the workers job asks for as are left, waiting for one at
+ * least; 0 when it is cancelled meanwhile */
+static int take_workers(filter_job *job){
+	int n, most;
+
+	most=parallel_threads(0);
+	n=parallel_threads(job->opts.threads);
+	STATIC_LOCK(&budget_lock);
+	while(workers_taken>=most && !job->cancel)
+		STATIC_WAIT(&budget_freed,&budget_lock);
+	if(job->cancel)
+		n=0;
+	else if(n>most-workers_taken)
+		n=most-workers_taken;
+	workers_taken+=n;
+	STATIC_UNLOCK(&budget_lock);
+	return n;
+}
+
+/* give n workers of take_workers() back */
+static void give_workers(int n){
+	STATIC_LOCK(&budget_lock);
+	workers_taken-=n;
+	WAKE_ALL(&budget_freed);
+	STATIC_UNLOCK(&budget_lock);
+}
+
+static THREAD_RESULT job_main(thread_arg arg){
+	run_job((filter_job*)arg);
+	return 0;
+}
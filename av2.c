@@ -0,0 +1,337 @@
+/* av2.c */
+
+/* the local mean filter of AV2_M.c, which lists its methods */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "arena.h"
+#include "border.h"
+#include "cache.h"
+#include "filters.h"
+#include "frames.h"
+#include "gauss.h"
+#include "parallel.h"
+#include "stats.h"
+#include "typed.h"
+
+#define METHOD_DIRECT	0
+#define METHOD_BOX	1
+#define METHOD_GAUSS	2
+
+static const char *method_names[]={"direct", "box", "gauss"};
+
+/* everything a worker needs to filter one tile */
+typedef struct {
+	border *m_in;			/* each frame and its padding */
+	double **m_out;			/* rows of every frame */
+	int no_rows, no_cols;
+	int win_rows, win_cols;		/* window height and width */
+	int method;
+	double sigma_r, sigma_c;	/* of METHOD_GAUSS */
+	arena *arenas;			/* scratch of each worker */
+	typed_image image;		/* the caller's data, whatever its class */
+	int typed;			/* staged a tile at a time, see typed.h */
+} filter_args;
+
+/* prototypes */
+static int filter_pass(const filter_data*, const int*,
+						const filter_options*);
+static void filter_tile(void*, int, int, int, int, int, int);
+static size_t scratch_size(filter_args*, tile_plan*);
+static void filter(border*, double**, int, int, int, int, int, int, int,
+							int, arena*);
+static void filter_box(border*, double**, int, int, int, int, int, int, int,
+							int, arena*);
+static double column_sum(border*, int, int, int);
+static void filter_gauss(border*, double**, int, int, double, double, int,
+						int, int, int, arena*);
+static double fill(border*,double*,int,int,int,int,int,int);
+static double average(double*,int);
+static int get_method(const char*);
+
+/* filter d with windows of side ws, or opts->window (see filters.h) */
+int av2_filter(const filter_data *d, int ws, const filter_options *opts){
+	filter_options defaults;
+	int params[1];
+	
+	if(!opts){
+		filter_defaults(&defaults);
+		opts=&defaults;
+	}
+	params[0]=ws;
+	return frames_iterate(d,filter_pass,params,opts);
+}
+
+/* one pass of av2_filter(), params holding ws */
+static int filter_pass(const filter_data *d, const int *params,
+						const filter_options *opts){
+	int ws=params[0];
+	filter_args args;
+	tile_plan plan;
+	frames fr;
+	int rc;
+	size_t scratch;
+	double since;
+	
+	stats_start(opts->stats,&since);
+	args.method=get_method(opts->method);
+	if(args.method<0)
+		return FILTER_ERR_METHOD;
+	rc=frames_create(&fr,d,ws,opts);
+	if(rc!=FILTER_OK)
+		return rc;
+	rc=gauss_sigmas(opts,fr.win_rows,fr.win_cols,&args.sigma_r,
+							&args.sigma_c);
+	if(rc!=FILTER_OK){
+		frames_free(&fr);
+		return rc;
+	}
+	args.m_in=fr.pads;
+	args.m_out=fr.out;
+	args.no_rows=fr.no_rows;
+	args.no_cols=fr.no_cols;
+	args.win_rows=fr.win_rows;
+	args.win_cols=fr.win_cols;
+	args.image=fr.image;
+	args.typed=fr.typed;
+	plan_tiles(&plan,fr.no_frames,fr.r0,fr.r1,fr.c0,fr.c1,fr.win_rows,
+				fr.win_cols,parallel_threads(opts->threads));
+	stats_phase(opts->stats,FILTER_PHASE_SETUP,&since);
+	scratch=scratch_size(&args,&plan)
+		+(args.typed ? typed_scratch(plan.tile_rows,plan.tile_cols,
+					fr.win_rows,fr.win_cols) : 0);
+	args.arenas=cache_arenas(opts->cache,plan.nworkers,scratch,&fr.bytes);
+	if(!args.arenas){
+		frames_free(&fr);
+		return FILTER_ERR_MEMORY;
+	}
+	stats_phase(opts->stats,FILTER_PHASE_SCRATCH,&since);
+	frames_run(&fr,&plan,filter_tile,&args,cache_pool(opts->cache));
+	stats_phase(opts->stats,FILTER_PHASE_FILTER,&since);
+	stats_pass(opts->stats,&plan,fr.bytes,
+			"av2 %s%s",method_names[args.method],STATS_STAGED(args.typed));
+	rc=cache_done_arenas(opts->cache,args.arenas,plan.nworkers);
+	frames_free(&fr);
+	stats_phase(opts->stats,FILTER_PHASE_FINISH,&since);
+	return rc;
+}
+
+/* engine named by the 'method' option, -1 for none */
+static int get_method(const char *name){
+	if(!name[0] || !strcmp(name,"box"))
+		return METHOD_BOX;
+	if(!strcmp(name,"direct"))
+		return METHOD_DIRECT;
+	if(!strcmp(name,"gauss"))
+		return METHOD_GAUSS;
+	return -1;
+}
+
+/* filter one tile (runs on a worker thread, see parallel.h) */
+static void filter_tile(void *arg, int frame, int r0, int r1, int c0, int c1,
+								int worker){
+	filter_args *a=(filter_args*)arg;
+	arena *scratch=&a->arenas[worker];
+	border *in=a->m_in+frame;
+	double **out=a->m_out+(size_t)frame*a->no_rows;
+	int no_rows=a->no_rows, no_cols=a->no_cols;
+	typed_tile t;
+	
+	arena_reset(scratch);
+	if(setjmp(scratch->bail))
+		return;			/* out of memory, see arena.h */
+	
+	/* other classes are filtered through a double copy of the tile */
+	if(a->typed){
+		typed_load(&a->image,a->m_in,&t,frame,r0,r1,c0,c1,scratch);
+		in=&t.in;
+		out=t.out;
+		no_rows=t.no_rows;
+		no_cols=t.no_cols;
+		r0=c0=0;
+		r1=t.no_rows;
+		c1=t.no_cols;
+	}
+	
+	if(a->method==METHOD_BOX)
+		filter_box(in,out,no_rows,no_cols,a->win_rows,a->win_cols,
+						r0,r1,c0,c1,scratch);
+	else if(a->method==METHOD_GAUSS)
+		filter_gauss(in,out,a->win_rows,a->win_cols,a->sigma_r,
+				a->sigma_c,r0,r1,c0,c1,scratch);
+	else
+		filter(in,out,no_rows,no_cols,a->win_rows,a->win_cols,
+						r0,r1,c0,c1,scratch);
+	
+	if(a->typed)
+		typed_store(&a->image,&t);
+}
+
+/* scratch one worker needs for the largest tile */
+static size_t scratch_size(filter_args *a, tile_plan *plan){
+	size_t width=plan->tile_cols+a->win_cols-1;
+	
+	if(a->method==METHOD_BOX)
+		return ARENA_BYTES(width*sizeof(double))
+			+ARENA_BYTES((size_t)a->win_rows*a->win_cols
+							*sizeof(double));
+	if(a->method==METHOD_GAUSS)
+		return gauss_scratch(plan->tile_rows,plan->tile_cols,
+						a->win_rows,a->win_cols,0)
+			+ARENA_BYTES(plan->tile_rows*sizeof(double*));
+	return ARENA_BYTES((size_t)a->win_rows*a->win_cols*sizeof(double));
+}
+
+/* perform filtering of output rows r0..r1-1, columns c0..c1-1 */
+static void filter(border *m_in, double **m_out, int no_rows, int no_cols,
+		int win_rows, int win_cols, int r0, int r1, int c0, int c1,
+							arena *scratch){
+	int curRow, curCol;
+	int side_r, side_c, scale_r, scale_c;
+	double *kernel_array;		/* the taps of one window */
+	
+	side_r=win_rows;		/* size of kernel sides */
+	side_c=win_cols;
+	scale_r=(int)(side_r-1)/2;	/* "width" of kernel */
+	scale_c=(int)(side_c-1)/2;
+	kernel_array = (double*) arena_alloc (scratch,side_r*side_c*sizeof(double));
+		
+	/* filling output matrix by first filling kernel values and then
+	 * processing these kernel values */
+	for(curRow=r0; curRow<r1; curRow++){
+		for(curCol=c0; curCol<c1; curCol++)		
+			m_out[curRow][curCol]=fill(m_in,kernel_array,curRow,
+					curCol,side_r,side_c,scale_r,scale_c);
+	}
+}
+
+/* perform filtering with running sums, separably: a column sum is kept for
+ * every (padded) column of the current window rows and slid down one row at
+ * a time, then the window total is slid along the row, so each output pixel
+ * costs a handful of additions whatever the window height and width. A NaN
+ * or infinite tap would stay in the sums after leaving the window (NaN-NaN
+ * and Inf-Inf being NaN), so a sum that is not finite is added up again from
+ * its taps, and windows whose total still is not are averaged as filter()
+ * does */
+static void filter_box(border *m_in, double **m_out, int no_rows, int no_cols,
+		int win_rows, int win_cols, int r0, int r1, int c0, int c1,
+							arena *scratch){
+	int curRow, curCol, c, base, width;
+	int scale_r, reach_r, scale_c, reach_c;
+	double *colsum;			/* window columns c0-scale_c ..
+					 * c1+reach_c-1 */
+	int *colmap;			/* their input columns */
+	double *row_add, *row_sub, *kernel_array;
+	double total, length;
+	
+	scale_r=(int)(win_rows-1)/2;	/* taps before the centre, as in
+					 * filter() */
+	reach_r=win_rows-1-scale_r;	/* taps after the centre */
+	scale_c=(int)(win_cols-1)/2;
+	reach_c=win_cols-1-scale_c;
+	length=(double)win_rows*win_cols;
+	base=c0-scale_c;
+	width=c1-c0+win_cols-1;
+	
+	colsum = (double*) arena_alloc (scratch,width*sizeof(double));
+	kernel_array = (double*) arena_alloc (scratch,
+					(size_t)win_rows*win_cols*sizeof(double));
+	colmap=m_in->cols+base;
+	
+	/* column sums for the first row of windows */
+	for(c=0; c<width; c++)
+		colsum[c]=column_sum(m_in,colmap[c],r0-scale_r,r0+reach_r);
+	
+	for(curRow=r0; curRow<r1; curRow++){
+		/* slide the column sums down to the window rows of curRow */
+		if(curRow>r0){
+			row_sub=m_in->rows[curRow-scale_r-1];
+			row_add=m_in->rows[curRow+reach_r];
+			for(c=0; c<width; c++){
+				colsum[c]+=row_add[colmap[c]]-row_sub[colmap[c]];
+				if(!isfinite(colsum[c]))
+					colsum[c]=column_sum(m_in,colmap[c],
+						curRow-scale_r,curRow+reach_r);
+			}
+		}
+		/* slide the window total along the row */
+		total=0;
+		for(c=0; c<win_cols; c++)
+			total+=colsum[c];
+		for(curCol=c0; curCol<c1; curCol++){
+			if(curCol>c0)
+				total+=colsum[curCol+reach_c-base]
+					-colsum[curCol-scale_c-1-base];
+			if(!isfinite(total)){
+				total=0;
+				for(c=curCol-scale_c; c<=curCol+reach_c; c++)
+					total+=colsum[c-base];
+				if(!isfinite(total)){
+					m_out[curRow][curCol]=fill(m_in,kernel_array,
+						curRow,curCol,win_rows,win_cols,
+							scale_r,scale_c);
+					continue;
+				}
+			}
+			m_out[curRow][curCol]=total/length;
+		}
+	}
+}
+
+/* sum of rows r0..r1 of input column col */
+static double column_sum(border *m_in, int col, int r0, int r1){
+	double total=0;
+	int r;
+	
+	for(r=r0; r<=r1; r++)
+		total+=m_in->rows[r][col];
+	return total;
+}
+
+/* perform filtering with the recursive Gaussian of gauss.c, sigma_r and
+ * sigma_c wide, the windows being its padding */
+static void filter_gauss(border *m_in, double **m_out, int win_rows,
+		int win_cols, double sigma_r, double sigma_c, int r0, int r1,
+					int c0, int c1, arena *scratch){
+	double **mean;			/* the output rows, from column c0 */
+	int r;
+	
+	mean = (double**) arena_alloc (scratch,(r1-r0)*sizeof(double*));
+	for(r=r0; r<r1; r++)
+		mean[r-r0]=m_out[r]+c0;
+	gauss_tile(m_in,win_rows,win_cols,sigma_r,sigma_c,r0,r1,c0,c1,mean,0,
+								scratch);
+}
+
+/* "fill" kernel */
+static double fill(border *m_in,double *kernel_array,int curRow,int curCol,
+	int side_r,int side_c,int scale_r,int scale_c){
+				
+	int length=side_r*side_c;
+	int r, c, *cols;
+	double retVal, *row;
+		
+	/* filling the kernel_array, the padding coming from the tables of
+	 * border.h */
+	cols=m_in->cols+curCol-scale_c;
+	for(r=0; r<side_r; r++){
+	    	row=m_in->rows[curRow-scale_r+r];
+	    	for(c=0; c<side_c; c++)
+			/* kept in MATLAB row order (m_in is transposed) */
+			kernel_array[(side_r*c)+r]=row[cols[c]];
+	}
+				
+	/* processing the values within the kernel */	
+	retVal = average(kernel_array,length);
+	return retVal;
+}
+	
+/* "process" the kernel values */
+static double average(double* kernel, int length){
+	int i;
+	double total=0;
+	for(i=0; i<length; i++)
+		total+=kernel[i];
+	return (total/length);
+}
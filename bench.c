@@ -0,0 +1,701 @@
+/* bench.c */
+
+/* USAGE: bench [name value ...]
+ *
+ * times every filter and method of filters.h over a sweep of image sizes,
+ * window sizes and classes, printing per case the throughput (Mpixel/s of
+ * the median run), latency percentiles and the memory a call takes above
+ * what it was given, and checks each method against a plain per window
+ * reference on a crop of the image.
+ *
+ * 'filters':	comma separated list (default av2,med2,lee2,elee2)
+ * 'sizes':	square image sides (default 256,1024,4096; up to 16384 and
+ *		beyond when memory allows)
+ * 'windows':	window sizes, a side or RxC for R rows and C columns (default
+ *		3,7,15,31,63)
+ * 'classes':	input and output classes (default double,uint8)
+ * 'threads':	worker threads, 0 for the default
+ * 'reps':	timed runs per case after one warm up run (default 5)
+ * 'seconds':	stop timing a case once it took this long (default 5)
+ * 'work':	skip cases of more than this many window taps, so 'direct'
+ *		on large images and windows stays out of a default run
+ *		(default 4e9)
+ * 'check':	1 to check against the reference (default), 0 not to
+ * 'persistent':	1 to make every run with one filter_cache, as the mex
+ *		files' 'persistent' option does (default 0)
+ * 'save':	file to write the throughput of every case to
+ * 'baseline':	file written by 'save' to compare against, any case more
+ *		than 'tolerance' (default 0.10) slower failing the run
+ *
+ * Checking also measures the Lee blend of every instruction set up to the
+ * one in use against its scalar reference (weights_check()).
+ *
+ * Exits 1 when a check or the baseline comparison fails */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "filters.h"
+#include "gauss.h"
+#include "weights.h"
+
+#define MAX_LIST	16
+#define MAX_REPS	1000
+#define MAX_CASES	4096
+#define CHECK_SIDE	192	/* crop the reference runs on */
+#define CHECK_THREADS	4	/* workers of the checked runs, which one
+				 * worker must match to the bit */
+#define NLOOK		4	/* Lee parameters of every run */
+#define DAMP		1
+#define GAUSS_TOL	2e-3	/* of the input's span (its square for
+				 * variances), that the mean and variance of
+				 * 'gauss' may differ by from the sampled
+				 * Gaussian's */
+
+typedef struct {
+	const char *name;
+	const char *methods[5];		/* null terminated */
+	int (*run)(const filter_data*, int, const filter_options*);
+	int kind;			/* REF_ of the reference */
+} bench_filter;
+
+/* a result of a 'save' file */
+typedef struct {
+	char filter[16], method[16], cls[16];
+	char ws[16];
+	int size;
+	double mpix;
+} bench_case;
+
+#define REF_MEAN	0
+#define REF_MEDIAN	1
+#define REF_LEE		2
+#define REF_ELEE	3
+
+/* prototypes */
+static int run_lee2(const filter_data*, int, const filter_options*);
+static int run_elee2(const filter_data*, int, const filter_options*);
+static int parse_list(char*, const char**);
+static double now(void);
+static long memory_kb(const char*);
+static void reset_peak(void);
+static void fill_input(void*, int, size_t);
+static double element(const void*, int, size_t);
+static double convert(double, int);
+static const char *check(bench_filter*, const char*, int, int, int);
+static const char *check_nonfinite(bench_filter*, filter_data*, void*, int,
+					filter_options*, void*, void*);
+static double reference(int, const double*, int, int, int, int, int, int,
+						const double*, double, double, double*);
+static double *gauss_weights(int, int);
+static int reflect(int, int);
+static int compare_doubles(const void*, const void*);
+static int load_baseline(const char*, bench_case*);
+
+static bench_filter all_filters[]={
+	{ "av2", { "box", "gauss", "direct", 0 }, av2_filter, REF_MEAN },
+	{ "med2", { "hist", "sorted", "network", "direct", 0 }, med2_filter, REF_MEDIAN },
+	{ "lee2", { "moments", "gauss", "direct", 0 }, run_lee2, REF_LEE },
+	{ "elee2", { "moments", "gauss", "direct", 0 }, run_elee2, REF_ELEE }
+};
+
+static const char *class_names[]={
+	"same", "double", "single", "uint8", "uint16", "int16"
+};
+
+int main(int argc, char **argv){
+	char filters_arg[256]="av2,med2,lee2,elee2", sizes_arg[256]="256,1024,4096";
+	char windows_arg[256]="3,7,15,31,63", classes_arg[256]="double,uint8";
+	const char *names[MAX_LIST], *save=0, *baseline=0, *status;
+	const char *filter_names[MAX_LIST], *class_list[MAX_LIST];
+	int sizes[MAX_LIST], windows[MAX_LIST][2], classes[MAX_LIST];
+	const char *window_names[MAX_LIST];
+	int nfilters, nsizes, nwindows, nclasses, reps=5, checking=1;
+	int persistent=0;
+	int f, m, k, s, w, i, n, cls, wr, wc, size, rc, failed=0, nbase=0, isa;
+	char *x;
+	double seconds=5, work=4e9, tolerance=0.10, cost, start, total, mpix;
+	double ulps;
+	double times[MAX_REPS];
+	long rss, peak, extra;
+	size_t pixels, cached_pixels=0;
+	int cached_class=0;
+	void *in=0, *out=0;
+	bench_filter *bf;
+	filter_options opts;
+	filter_data d;
+	bench_case *base;
+	FILE *saved=0;
+
+	filter_defaults(&opts);
+	if((argc-1)%2!=0){
+		fprintf(stderr,"usage: bench [name value ...] (see bench.c)\n");
+		return 2;
+	}
+	for(i=1; i<argc; i+=2){
+		if(!strcmp(argv[i],"filters"))
+			strncpy(filters_arg,argv[i+1],sizeof(filters_arg)-1);
+		else if(!strcmp(argv[i],"sizes"))
+			strncpy(sizes_arg,argv[i+1],sizeof(sizes_arg)-1);
+		else if(!strcmp(argv[i],"windows"))
+			strncpy(windows_arg,argv[i+1],sizeof(windows_arg)-1);
+		else if(!strcmp(argv[i],"classes"))
+			strncpy(classes_arg,argv[i+1],sizeof(classes_arg)-1);
+		else if(!strcmp(argv[i],"threads"))
+			opts.threads=atoi(argv[i+1]);
+		else if(!strcmp(argv[i],"reps"))
+			reps=atoi(argv[i+1]);
+		else if(!strcmp(argv[i],"seconds"))
+			seconds=atof(argv[i+1]);
+		else if(!strcmp(argv[i],"work"))
+			work=atof(argv[i+1]);
+		else if(!strcmp(argv[i],"check"))
+			checking=atoi(argv[i+1]);
+		else if(!strcmp(argv[i],"persistent"))
+			persistent=atoi(argv[i+1]);
+		else if(!strcmp(argv[i],"save"))
+			save=argv[i+1];
+		else if(!strcmp(argv[i],"baseline"))
+			baseline=argv[i+1];
+		else if(!strcmp(argv[i],"tolerance"))
+			tolerance=atof(argv[i+1]);
+		else{
+			fprintf(stderr,"bench: unknown option %s\n",argv[i]);
+			return 2;
+		}
+	}
+	if(reps<1)
+		reps=1;
+	if(reps>MAX_REPS)
+		reps=MAX_REPS;
+
+	nfilters=parse_list(filters_arg,filter_names);
+	nsizes=parse_list(sizes_arg,names);
+	for(i=0; i<nsizes; i++)
+		sizes[i]=atoi(names[i]);
+	nwindows=parse_list(windows_arg,window_names);
+	for(i=0; i<nwindows; i++){
+		windows[i][0]=windows[i][1]=atoi(window_names[i]);
+		if((x=strchr(window_names[i],'x')))
+			windows[i][1]=atoi(x+1);
+	}
+	nclasses=parse_list(classes_arg,class_list);
+	for(i=0; i<nclasses; i++){
+		classes[i]=filter_class_named(class_list[i]);
+		if(classes[i]<=FILTER_SAME){
+			fprintf(stderr,"bench: unknown class %s\n",class_list[i]);
+			return 2;
+		}
+	}
+	base=(bench_case*)malloc(MAX_CASES*sizeof(bench_case));
+	if(!base)
+		return 1;
+	if(baseline)
+		nbase=load_baseline(baseline,base);
+	if(save && !(saved=fopen(save,"w"))){
+		fprintf(stderr,"bench: cannot write %s\n",save);
+		return 2;
+	}
+	if(persistent && !(opts.cache=filter_cache_create()))
+		return 1;
+
+	printf("blend: %s",weights_isa_name(weights_isa()));
+	for(isa=WEIGHTS_SCALAR; checking && isa<=weights_isa(); isa++){
+		ulps=weights_check(isa);
+		printf("%s%s %g ulp%s",isa ? ", " : " (",weights_isa_name(isa),
+				ulps,ulps>WEIGHTS_MAX_ULP ? " FAIL" : "");
+		if(ulps>WEIGHTS_MAX_ULP)
+			failed=1;
+	}
+	printf("%s\n",checking ? ")" : "");
+	printf("%-6s %-8s %-7s %6s %5s %9s %9s %9s %9s %8s  %s\n","filter",
+		"method","class","size","ws","Mpix/s","p50 ms","p90 ms","max ms",
+		"extra MB","check");
+	for(f=0; f<nfilters; f++){
+		bf=0;
+		for(i=0; i<(int)(sizeof(all_filters)/sizeof(all_filters[0])); i++)
+			if(!strcmp(filter_names[f],all_filters[i].name))
+				bf=&all_filters[i];
+		if(!bf){
+			fprintf(stderr,"bench: unknown filter %s\n",filter_names[f]);
+			return 2;
+		}
+		for(m=0; bf->methods[m]; m++)
+		for(k=0; k<nclasses; k++)
+		for(w=0; w<nwindows; w++){
+			cls=classes[k];
+			wr=windows[w][0];
+			wc=windows[w][1];
+			opts.window[0]=wr;
+			opts.window[1]=wc;
+			strcpy(opts.method,bf->methods[m]);
+			status=checking ? check(bf,bf->methods[m],cls,wr,wc) : "-";
+			if(!strcmp(status,"FAIL"))
+				failed=1;
+			for(s=0; s<nsizes; s++){
+				size=sizes[s];
+				pixels=(size_t)size*size;
+				cost=!strcmp(bf->methods[m],"direct") ? (double)wr*wc
+					: !strcmp(bf->methods[m],"sorted") ? wr : 1;
+				printf("%-6s %-8s %-7s %6d %5s ",bf->name,bf->methods[m],
+						class_names[cls],size,window_names[w]);
+				if(pixels*cost>work){
+					printf("%9s\n","skipped");
+					continue;
+				}
+				if(pixels!=cached_pixels || cls!=cached_class){
+					free(in);
+					free(out);
+					in=malloc(pixels*filter_class_size(cls)+1);
+					out=malloc(pixels*filter_class_size(cls)+1);
+					if(!in || !out){
+						printf("%9s\n","no memory");
+						cached_pixels=0;
+						continue;
+					}
+					fill_input(in,cls,pixels);
+					cached_pixels=pixels;
+					cached_class=cls;
+				}
+				d.in_class=d.out_class=cls;
+				d.in=in;
+				d.out=out;
+				d.no_rows=d.no_cols=size;
+				d.no_frames=1;
+
+				/* a warm up run, then timed runs */
+				rc=bf->run(&d,wr,&opts);
+				if(rc!=FILTER_OK){
+					printf("%9s  (%s)\n","n/a",filter_message(rc));
+					continue;
+				}
+				extra=0;
+				total=0;
+				for(n=0; n<reps && (n==0 || total<seconds); n++){
+					rss=memory_kb("VmRSS:");
+					reset_peak();
+					start=now();
+					bf->run(&d,wr,&opts);
+					times[n]=now()-start;
+					total+=times[n];
+					peak=memory_kb("VmHWM:");
+					if(rss>=0 && peak-rss>extra)
+						extra=peak-rss;
+				}
+				qsort(times,n,sizeof(double),compare_doubles);
+				mpix=pixels/times[(n-1)/2]/1e6;
+				printf("%9.1f %9.2f %9.2f %9.2f %8.1f  %s",mpix,
+					1e3*times[(n-1)/2],1e3*times[(int)ceil(0.9*n)-1],
+					1e3*times[n-1],extra/1024.0,status);
+				if(saved)
+					fprintf(saved,"%s %s %s %d %s %.3f\n",bf->name,
+						bf->methods[m],class_names[cls],size,
+						window_names[w],mpix);
+				for(i=0; i<nbase; i++){
+					if(strcmp(base[i].filter,bf->name)
+					    || strcmp(base[i].method,bf->methods[m])
+					    || strcmp(base[i].cls,class_names[cls])
+					    || base[i].size!=size
+					    || strcmp(base[i].ws,window_names[w]))
+						continue;
+					if(mpix<base[i].mpix*(1-tolerance)){
+						printf("  SLOWER than %.1f",base[i].mpix);
+						failed=1;
+					}
+				}
+				printf("\n");
+				fflush(stdout);
+			}
+		}
+	}
+	if(saved)
+		fclose(saved);
+	filter_cache_free(opts.cache);
+	free(in);
+	free(out);
+	free(base);
+	return failed;
+}
+
+static int run_lee2(const filter_data *d, int ws, const filter_options *opts){
+	return lee2_filter(d,ws,NLOOK,opts);
+}
+
+static int run_elee2(const filter_data *d, int ws, const filter_options *opts){
+	return elee2_filter(d,ws,NLOOK,DAMP,opts);
+}
+
+/* split a comma separated list in place */
+static int parse_list(char *list, const char **items){
+	int n=0;
+	char *p;
+
+	for(p=strtok(list,","); p && n<MAX_LIST; p=strtok(0,","))
+		items[n++]=p;
+	return n;
+}
+
+static double now(void){
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC,&t);
+	return t.tv_sec+1e-9*t.tv_nsec;
+}
+
+/* a kB field of /proc/self/status, -1 where there is none */
+static long memory_kb(const char *field){
+	char line[256];
+	long kb=-1;
+	FILE *f;
+
+	f=fopen("/proc/self/status","r");
+	if(!f)
+		return -1;
+	while(fgets(line,sizeof(line),f))
+		if(!strncmp(line,field,strlen(field)))
+			kb=atol(line+strlen(field));
+	fclose(f);
+	return kb;
+}
+
+/* restart the peak memory_kb("VmHWM:") reports (Linux 4.0 and up) */
+static void reset_peak(void){
+	FILE *f;
+
+	f=fopen("/proc/self/clear_refs","w");
+	if(f){
+		fputs("5",f);
+		fclose(f);
+	}
+}
+
+/* speckle-like positive values, whole numbers of 8 bits for uint8 and of 12
+ * for the other integer classes (so med2 can bin them) */
+static void fill_input(void *data, int cls, size_t n){
+	size_t i;
+	double u;
+
+	srand(1);
+	for(i=0; i<n; i++){
+		u=rand()/(double)RAND_MAX;
+		switch(cls){
+		case FILTER_DOUBLE:
+			((double*)data)[i]=1+100*u*u;
+			break;
+		case FILTER_SINGLE:
+			((float*)data)[i]=(float)(1+100*u*u);
+			break;
+		case FILTER_UINT8:
+			((unsigned char*)data)[i]=(unsigned char)(255*u*u);
+			break;
+		case FILTER_UINT16:
+			((unsigned short*)data)[i]=(unsigned short)(4095*u*u);
+			break;
+		default:
+			((short*)data)[i]=(short)(4095*u*u-100);
+		}
+	}
+}
+
+static double element(const void *data, int cls, size_t i){
+	switch(cls){
+	case FILTER_SINGLE:	return ((const float*)data)[i];
+	case FILTER_UINT8:	return ((const unsigned char*)data)[i];
+	case FILTER_UINT16:	return ((const unsigned short*)data)[i];
+	case FILTER_INT16:	return ((const short*)data)[i];
+	}
+	return ((const double*)data)[i];
+}
+
+/* x as stored in class cls, rounded and saturated as MATLAB does */
+static double convert(double x, int cls){
+	double lo, hi;
+
+	if(cls==FILTER_DOUBLE)
+		return x;
+	if(cls==FILTER_SINGLE)
+		return (float)x;
+	if(x!=x)
+		return 0;
+	lo=cls==FILTER_UINT8 || cls==FILTER_UINT16 ? 0 : -32768;
+	hi=cls==FILTER_UINT8 ? 255 : cls==FILTER_UINT16 ? 65535 : 32767;
+	x=x<0 ? -floor(-x+0.5) : floor(x+0.5);
+	return x<lo ? lo : x>hi ? hi : x;
+}
+
+/* "ok" when method of bf gives what reference() does on a crop of the input
+ * of class cls with windows of wr rows and wc columns, "n/a" when the method
+ * does not take the input, else "FAIL". The Lee filters must do so with
+ * every blend instruction set up to weights_isa(), and every filter with
+ * one worker as with CHECK_THREADS. Values within rounding of
+ * the reference pass: one step for integer classes, which can round a value
+ * that sits on .5 apart. 'gauss' is checked against the Gaussian sampled
+ * over the window, which its recursion (see gauss.c) matches to GAUSS_TOL.
+ * The running sums of 'box' and 'moments' must also give the NaN and
+ * infinite outputs 'direct' does (check_nonfinite()) */
+static const char *check(bench_filter *bf, const char *method, int cls,
+							int wr, int wc){
+	filter_options opts;
+	filter_data d;
+	void *in, *out[WEIGHTS_AVX512+1]={0}, *one;
+	double *img, *win, *weights=0, ref, got, tol, lo, hi, span, x, slack;
+	int r, c, n=CHECK_SIDE, rows=CHECK_SIDE, cols=CHECK_SIDE-5, rc, k, i;
+	int nout, capped;
+	char kept_isa[32]="";
+	const char *status="ok";
+
+	/* the Lee filters once per instruction set up to the one in use,
+	 * capped with FILTER_ISA, so that every blend is checked */
+	nout=bf->kind==REF_LEE || bf->kind==REF_ELEE ? weights_isa()+1 : 1;
+
+	/* not square, to catch rows and columns swapped */
+	in=malloc((size_t)n*n*sizeof(double));
+	one=malloc((size_t)n*n*sizeof(double));
+	for(i=0, k=1; i<nout; i++)
+		k=(out[i]=malloc((size_t)n*n*sizeof(double))) && k;
+	img=(double*)malloc((size_t)n*n*sizeof(double));
+	win=(double*)malloc((size_t)wr*wc*sizeof(double));
+	if(!strcmp(method,"gauss"))
+		weights=gauss_weights(wr,wc);
+	if(!in || !one || !k || !img || !win
+	    || (!strcmp(method,"gauss") && !weights)){
+		free(in); free(one); free(img); free(win); free(weights);
+		for(i=0; i<nout; i++)
+			free(out[i]);
+		return "no memory";
+	}
+	fill_input(in,cls,(size_t)rows*cols);
+	lo=hi=element(in,cls,0);
+	for(r=0; r<rows*cols; r++){
+		img[r]=element(in,cls,r);
+		lo=img[r]<lo ? img[r] : lo;
+		hi=img[r]>hi ? img[r] : hi;
+	}
+	span=hi-lo;
+	filter_defaults(&opts);
+	strcpy(opts.method,method);
+	opts.threads=CHECK_THREADS;
+	opts.window[0]=wr;
+	opts.window[1]=wc;
+	d.in_class=d.out_class=cls;
+	d.in=in;
+	d.no_rows=rows;
+	d.no_cols=cols;
+	d.no_frames=1;
+	capped=getenv("FILTER_ISA")!=0;
+	if(capped)
+		strncpy(kept_isa,getenv("FILTER_ISA"),sizeof(kept_isa)-1);
+	for(i=0; i<nout && !strcmp(status,"ok"); i++){
+		if(nout>1)
+			setenv("FILTER_ISA",weights_isa_name(i),1);
+		d.out=out[i];
+		rc=bf->run(&d,wr,&opts);
+		if(rc==FILTER_ERR_HIST)
+			status="n/a";
+		else if(rc!=FILTER_OK)
+			status="FAIL";
+	}
+	if(nout>1 && capped)
+		setenv("FILTER_ISA",kept_isa,1);
+	else if(nout>1)
+		unsetenv("FILTER_ISA");
+
+	/* the tiling not depending on the thread count (see parallel.h), one
+	 * worker gives the same to the bit, 'gauss' whose recursions start at
+	 * the tile edges too */
+	if(!strcmp(status,"ok")){
+		opts.threads=1;
+		d.out=one;
+		if(bf->run(&d,wr,&opts)!=FILTER_OK || memcmp(one,out[nout-1],
+				(size_t)rows*cols*filter_class_size(cls)))
+			status="FAIL";
+	}
+	for(c=0; c<cols && !strcmp(status,"ok"); c++){
+		for(r=0; r<rows && !strcmp(status,"ok"); r++){
+			ref=convert(reference(bf->kind,img,rows,cols,r,c,wr,wc,
+						weights,0,0,win),cls);
+			tol=cls==FILTER_DOUBLE ? 1e-9*(1+fabs(ref))
+				: cls==FILTER_SINGLE ? 1e-6*(1+fabs(ref)) : 1;
+			/* as far as the reference moves with its mean and
+			 * variance off by GAUSS_TOL, which for Lee's blend
+			 * of a smooth patch can be far, and without bound
+			 * where the variance (NaN) or the mean could be 0 */
+			for(k=0, slack=0; weights && k<4; k++){
+				x=reference(bf->kind,img,rows,cols,r,c,wr,wc,
+					weights,(k&1 ? 1 : -1)*GAUSS_TOL*span,
+					(k&2 ? 1 : -1)*GAUSS_TOL*span*span,win);
+				x=x!=x ? HUGE_VAL : fabs(convert(x,cls)-ref);
+				slack=x>slack ? x : slack;
+			}
+			if(weights && bf->kind!=REF_MEAN
+			    && fabs(reference(REF_MEAN,img,rows,cols,r,c,wr,wc,
+					weights,0,0,win))<=GAUSS_TOL*span)
+				slack=HUGE_VAL;
+			tol+=slack;
+			for(i=0; i<nout && tol<HUGE_VAL; i++){
+				got=element(out[i],cls,(size_t)c*rows+r);
+				if(ref!=ref ? got==got : !(fabs(got-ref)<=tol))
+					status="FAIL";
+			}
+		}
+	}
+	if(!strcmp(status,"ok") && (cls==FILTER_DOUBLE || cls==FILTER_SINGLE)
+	    && (!strcmp(method,"box") || !strcmp(method,"moments")))
+		status=check_nonfinite(bf,&d,in,wr,&opts,one,out[0]);
+	free(in);
+	free(one);
+	for(i=0; i<nout; i++)
+		free(out[i]);
+	free(img);
+	free(win);
+	free(weights);
+	return status;
+}
+
+/* "ok" when the method of opts gives the NaN and infinite outputs 'direct'
+ * does once d's input (in, of a floating point class) has NaN and infinite
+ * pixels, a pair of opposite infinities sharing windows and some on the
+ * edges and the first row of a tile, else "FAIL". a and b are room for
+ * the outputs */
+static const char *check_nonfinite(bench_filter *bf, filter_data *d, void *in,
+			int wr, filter_options *opts, void *a, void *b){
+	double bad[]={ NAN, HUGE_VAL, -HUGE_VAL, HUGE_VAL, NAN, NAN, -HUGE_VAL };
+	int at[][2]={ { 96, 93 }, { 10, 20 }, { 11, 21 }, { 0, 0 }, { 0, 50 },
+			{ 128, 100 }, { -1, -1 } };
+	int i, r, c;
+	size_t n=(size_t)d->no_rows*d->no_cols;
+	double x, y;
+	char method[32];
+
+	for(i=0; i<(int)(sizeof(bad)/sizeof(bad[0])); i++){
+		r=at[i][0]<0 ? d->no_rows-1 : at[i][0];
+		c=at[i][1]<0 ? d->no_cols-1 : at[i][1];
+		if(d->in_class==FILTER_SINGLE)
+			((float*)in)[(size_t)c*d->no_rows+r]=(float)bad[i];
+		else
+			((double*)in)[(size_t)c*d->no_rows+r]=bad[i];
+	}
+	d->out=a;
+	if(bf->run(d,wr,opts)!=FILTER_OK)
+		return "FAIL";
+	strcpy(method,opts->method);
+	strcpy(opts->method,"direct");
+	d->out=b;
+	i=bf->run(d,wr,opts);
+	strcpy(opts->method,method);
+	if(i!=FILTER_OK)
+		return "FAIL";
+	for(i=0; i<(int)n; i++){
+		x=element(a,d->out_class,i);
+		y=element(b,d->out_class,i);
+		if((x!=x)!=(y!=y) || ((fabs(x)==HUGE_VAL || fabs(y)==HUGE_VAL)
+								&& x!=y))
+			return "FAIL";
+	}
+	return "ok";
+}
+
+/* filter kind at row r, column c of the column-major rows x cols img, the
+ * wr x wc window gathered with mirrored edges into win one window row after
+ * another, as the original filters gathered it. With weights (laid out as
+ * win, summing to 1) the mean and variance are weighted by them, as method
+ * 'gauss' has them, then moved by dmean and dvar; the centre is the same tap
+ * either way */
+static double reference(int kind, const double *img, int rows, int cols,
+		int r, int c, int wr, int wc, const double *weights,
+				double dmean, double dvar, double *win){
+	int i, j, n=wr*wc, centre=(n-1)/2;
+	double mean=0, var=0;
+
+	for(i=0; i<wr; i++)
+		for(j=0; j<wc; j++)
+			win[i*wc+j]=img[(size_t)reflect(c-(wc-1)/2+j,cols)*rows
+						+reflect(r-(wr-1)/2+i,rows)];
+	if(weights){
+		for(i=0; i<n; i++)
+			mean+=weights[i]*win[i];
+		for(i=0; i<n; i++)
+			var+=weights[i]*(win[i]-mean)*(win[i]-mean);
+		mean+=dmean;
+		var+=dvar;
+	}
+	else{
+		for(i=0; i<n; i++)
+			mean+=win[i];
+		mean/=n;
+		for(i=0; i<n; i++)
+			var+=(win[i]-mean)*(win[i]-mean);
+		var/=n;
+	}
+	if(kind==REF_MEAN)
+		return mean;
+	if(kind==REF_MEDIAN){
+		qsort(win,n,sizeof(double),compare_doubles);
+		return win[(n-1)/2];
+	}
+	if(kind==REF_LEE)
+		return lee_weight(win[centre],mean,var,NLOOK);
+	return elee_weight(win[centre],mean,var,NLOOK,DAMP);
+}
+
+/* the weights of a wr x wc window of the Gaussian method 'gauss' makes by
+ * default, sampled and cut at the window (malloc'ed, null when out of
+ * memory) */
+static double *gauss_weights(int wr, int wc){
+	double *w, sr, sc, di, dj, total=0;
+	int i, j;
+
+	w=(double*)malloc((size_t)wr*wc*sizeof(double));
+	if(!w)
+		return 0;
+	sr=(wr-1)/2/3.0;
+	sc=(wc-1)/2/3.0;
+	sr=sr<GAUSS_MIN_SIGMA ? GAUSS_MIN_SIGMA : sr;
+	sc=sc<GAUSS_MIN_SIGMA ? GAUSS_MIN_SIGMA : sc;
+	for(i=0; i<wr; i++)
+		for(j=0; j<wc; j++){
+			di=i-(wr-1)/2;
+			dj=j-(wc-1)/2;
+			/* sides below 3 are not smoothed */
+			if((wr<3 && di!=0) || (wc<3 && dj!=0))
+				w[i*wc+j]=0;
+			else
+				w[i*wc+j]=exp(-di*di/(2*sr*sr)-dj*dj/(2*sc*sc));
+			total+=w[i*wc+j];
+		}
+	for(i=0; i<wr*wc; i++)
+		w[i]/=total;
+	return w;
+}
+
+/* mirror an index into 0..n-1, -1 being 0 */
+static int reflect(int i, int n){
+	while(i<0 || i>=n)
+		i=i<0 ? -i-1 : 2*n-i-1;
+	return i;
+}
+
+static int compare_doubles(const void *a, const void *b){
+	double x=*(const double*)a, y=*(const double*)b;
+
+	return x<y ? -1 : x>y;
+}
+
+static int load_baseline(const char *path, bench_case *base){
+	FILE *f;
+	int n=0;
+
+	f=fopen(path,"r");
+	if(!f){
+		fprintf(stderr,"bench: cannot read %s\n",path);
+		exit(2);
+	}
+	while(n<MAX_CASES && fscanf(f,"%15s %15s %15s %d %15s %lf",base[n].filter,
+			base[n].method,base[n].cls,&base[n].size,base[n].ws,
+			&base[n].mpix)==6)
+		n++;
+	fclose(f);
+	return n;
+}
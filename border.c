@@ -0,0 +1,117 @@
+/* border.c */
+
+#include <stdlib.h>
+#include <string.h>
+#include "border.h"
+
+/* tables for the no_rows x no_cols image m_in and windows of win_rows x
+ * win_cols, the
+ * padding being value for BORDER_CONSTANT. Mirror, replicate and wrap map
+ * onto the image itself, constant needs values that are not in it and pays
+ * for one copy of the image with a halo of value around it. With m_in null
+ * (inputs other than double, see typed.h) only rowmap and colmap are made.
+ * Returns FILTER_OK or FILTER_ERR_MEMORY, b needing border_free() either
+ * way. border_point() puts the tables onto another image of the size */
+int border_create(border *b, double **m_in, int no_rows, int no_cols,
+		int win_rows, int win_cols, int policy, double value){
+	int r, c, rp, cp;
+	size_t stride;
+
+	rp=win_rows/2;		/* taps after the centre, never fewer before */
+	cp=win_cols/2;
+	b->no_rows=no_rows;
+	b->no_cols=no_cols;
+	b->row_pad=rp;
+	b->col_pad=cp;
+	b->policy=policy;
+	b->value=value;
+	b->padded=0;
+	b->row_block=0;
+	b->col_block=0;
+	b->rows=0;
+	b->cols=0;
+	b->bytes=(no_rows+no_cols+2*rp+2*cp)*sizeof(int);
+	b->map_block = (int*) malloc (b->bytes);
+	if(!b->map_block)
+		return FILTER_ERR_MEMORY;
+	b->rowmap=b->map_block+rp;
+	b->colmap=b->rowmap+no_rows+rp+cp;
+	if(no_rows==0 || no_cols==0)
+		return FILTER_OK;
+	for(r=-rp; r<no_rows+rp; r++)
+		b->rowmap[r]=border_index(r,no_rows,policy);
+	for(c=-cp; c<no_cols+cp; c++)
+		b->colmap[c]=border_index(c,no_cols,policy);
+	if(!m_in)
+		return FILTER_OK;
+	
+	b->row_block = (double**) malloc ((no_rows+2*rp)*sizeof(double*));
+	b->col_block = (int*) malloc ((no_cols+2*cp)*sizeof(int));
+	b->bytes+=(no_rows+2*rp)*sizeof(double*)+(no_cols+2*cp)*sizeof(int);
+	if(!b->row_block || !b->col_block)
+		return FILTER_ERR_MEMORY;
+	b->rows=b->row_block+rp;
+	b->cols=b->col_block+cp;
+
+	if(policy==BORDER_CONSTANT){
+		stride=no_cols+2*cp;
+		b->padded = (double*) malloc ((no_rows+2*rp)*stride*sizeof(double));
+		b->bytes+=(no_rows+2*rp)*stride*sizeof(double);
+		if(!b->padded)
+			return FILTER_ERR_MEMORY;
+		for(r=-rp; r<no_rows+rp; r++){
+			b->rows[r]=b->padded+(r+rp)*stride+cp;
+			for(c=-cp; c<no_cols+cp; c++)
+				b->rows[r][c]=value;
+		}
+		for(c=-cp; c<no_cols+cp; c++)
+			b->cols[c]=c;
+	}
+	else
+		for(c=-cp; c<no_cols+cp; c++)
+			b->cols[c]=b->colmap[c];
+	border_point(b,m_in);
+	return FILTER_OK;
+}
+
+/* the rows of b onto m_in, an image of the size b was made for (nothing
+ * to do when b has maps only). BORDER_CONSTANT copies it into the halo */
+void border_point(border *b, double **m_in){
+	int r;
+
+	if(!b->rows || !m_in || b->no_cols==0)
+		return;
+	if(b->policy==BORDER_CONSTANT){
+		for(r=0; r<b->no_rows; r++)
+			memcpy(b->rows[r],m_in[r],b->no_cols*sizeof(double));
+		return;
+	}
+	for(r=-b->row_pad; r<b->no_rows+b->row_pad; r++)
+		b->rows[r]=m_in[b->rowmap[r]];
+}
+
+void border_free(border *b){
+	free(b->map_block); b->map_block=0;
+	free(b->row_block); b->row_block=0;
+	free(b->col_block); b->col_block=0;
+	free(b->padded); b->padded=0;
+}
+
+/* index within 0..n-1 standing in for pos (n>0), -1 when BORDER_CONSTANT
+ * pads it. Mirror is the padding of the original fill(), reflecting again
+ * for windows wider than the image */
+int border_index(int pos, int n, int policy){
+	if(policy==BORDER_CONSTANT)
+		return pos<0 || pos>=n ? -1 : pos;
+	if(policy==BORDER_REPLICATE)
+		return pos<0 ? 0 : pos>=n ? n-1 : pos;
+	if(policy==BORDER_WRAP)
+		return (pos%n+n)%n;
+	while(pos<0 || pos>=n){
+		if(pos<0)
+			pos=-pos-1;
+		if(pos>=n)
+			pos=2*n-pos-1;
+	}
+	return pos;
+}
@@ -0,0 +1,34 @@
+/* border.h */
+
+/* padding of the windows that reach past the image. Every row and column a
+ * window can touch, -pad .. n+pad-1 (row_pad of them above and below,
+ * col_pad left and right), is looked up once per call in a table,
+ * so the filter loops read any tap as rows[r][cols[c]], without a branch and
+ * whatever the border policy (the BORDER_ policies of filters.h). Built
+ * before the workers start, read only by them */
+
+#ifndef BORDER_H
+#define BORDER_H
+
+#include "filters.h"
+
+typedef struct {
+	double **rows;		/* rows[-row_pad .. no_rows+row_pad-1] */
+	int *cols;		/* cols[-col_pad .. no_cols+col_pad-1] */
+	int *rowmap, *colmap;	/* input row and column standing in for each
+				 * position, -1 for the BORDER_CONSTANT value */
+	int no_rows, no_cols, row_pad, col_pad;
+	int policy;
+	double value;		/* BORDER_CONSTANT only */
+	double **row_block;	/* allocations behind rows and cols */
+	int *col_block, *map_block;
+	double *padded;		/* BORDER_CONSTANT: the image with a halo */
+	size_t bytes;		/* allocated for all of these */
+} border;
+
+int border_create(border*, double**, int, int, int, int, int, double);
+void border_point(border*, double**);
+void border_free(border*);
+int border_index(int, int, int);
+
+#endif
@@ -0,0 +1,205 @@
+/* cache.c */
+
+/* A cache hands out what it holds to one call at a time: whatever is out
+ * (taken and not yet done with) is made afresh for anyone else asking, and
+ * freed when done with as it would be without a cache. Arenas and the spare
+ * buffer only grow, tables are kept per geometry and the oldest go first */
+
+#include <stdlib.h>
+#include "cache.h"
+
+struct filter_cache {
+	worker_pool *pool;		/* null until a run wants it */
+	arena *arenas;			/* narenas of arena_size bytes */
+	int narenas, arenas_out;
+	size_t arena_size;
+	void *spare;			/* of spare_size bytes */
+	size_t spare_size;
+	int spare_out;
+	frames kept[CACHE_FRAMES];	/* tables, pads null when unused */
+	unsigned long age[CACHE_FRAMES];	/* clock when kept */
+	unsigned long clock;
+};
+
+/* prototypes */
+static int same_geometry(const frames*, const frames*,
+						const filter_options*);
+
+/* an empty cache, null when out of memory */
+filter_cache *filter_cache_create(void){
+	return (filter_cache*)calloc(1,sizeof(filter_cache));
+}
+
+/* stop the threads of c and free everything it holds */
+void filter_cache_free(filter_cache *c){
+	int i;
+
+	if(!c)
+		return;
+	pool_free(c->pool);
+	if(c->arenas)
+		arena_destroy(c->arenas,c->narenas);
+	free(c->spare);
+	for(i=0; i<CACHE_FRAMES; i++)
+		if(c->kept[i].pads)
+			frames_free(&c->kept[i]);
+	free(c);
+}
+
+/* the worker threads of c, started on first use; null (threads of each
+ * run's own) without a cache or when they cannot be had */
+worker_pool *cache_pool(filter_cache *c){
+	if(!c)
+		return 0;
+	if(!c->pool)
+		c->pool=pool_create();
+	return c->pool;
+}
+
+/* n arenas of at least size bytes, adding what had to be allocated to
+ * *bytes; null when out of memory. Give back with cache_done_arenas() */
+arena *cache_arenas(filter_cache *c, int n, size_t size, size_t *bytes){
+	arena *a;
+
+	if(c && !c->arenas_out && c->arenas && c->narenas>=n
+	    && c->arena_size>=ARENA_BYTES(size)){
+		c->arenas_out=1;
+		return c->arenas;
+	}
+	if(c && !c->arenas_out && c->arenas){
+		/* grown to fit both, so calls alternating between sizes
+		 * settle */
+		if(n<c->narenas)
+			n=c->narenas;
+		if(size<c->arena_size)
+			size=c->arena_size;
+		arena_destroy(c->arenas,c->narenas);
+		c->arenas=0;
+	}
+	a=arena_create(n,size);
+	if(!a)
+		return 0;
+	*bytes+=n*ARENA_BYTES(size);
+	if(c && !c->arenas_out){
+		c->arenas=a;
+		c->narenas=n;
+		c->arena_size=ARENA_BYTES(size);
+		c->arenas_out=1;
+	}
+	return a;
+}
+
+/* the n arenas a of cache_arenas() are done with, the workers having
+ * finished: FILTER_ERR_MEMORY when a tile ran out of memory in one (see
+ * arena.h), else FILTER_OK */
+int cache_done_arenas(filter_cache *c, arena *a, int n){
+	int i, rc=FILTER_OK;
+
+	for(i=0; i<n; i++)
+		if(a[i].failed)
+			rc=FILTER_ERR_MEMORY;
+	if(c && a==c->arenas){
+		for(i=0; i<c->narenas; i++){
+			arena_reset(&a[i]);
+			a[i].failed=0;
+		}
+		c->arenas_out=0;
+		return rc;
+	}
+	arena_destroy(a,n);
+	return rc;
+}
+
+/* a buffer of at least bytes, adding what had to be allocated to stats
+ * (unless null); null when out of memory. Give back with
+ * cache_done_spare() */
+void *cache_spare(filter_cache *c, size_t bytes, filter_stats *stats){
+	void *p;
+
+	if(c && !c->spare_out && c->spare && c->spare_size>=bytes){
+		c->spare_out=1;
+		return c->spare;
+	}
+	p=malloc(bytes+1);
+	if(!p)
+		return 0;
+	if(stats)
+		stats->bytes+=bytes;
+	if(c && !c->spare_out){
+		free(c->spare);
+		c->spare=p;
+		c->spare_size=bytes;
+		c->spare_out=1;
+	}
+	return p;
+}
+
+/* the buffer p of cache_spare() is done with */
+void cache_done_spare(filter_cache *c, void *p){
+	if(c && p==c->spare){
+		c->spare_out=0;
+		return;
+	}
+	free(p);
+}
+
+/* give fr, set up by frames_create() up to its tables, the tables c kept
+ * for its geometry and opts' border, returning 1; 0 when c has none */
+int cache_take_frames(filter_cache *c, frames *fr, const filter_options *opts){
+	frames *k;
+	int i;
+
+	if(!c)
+		return 0;
+	for(i=0; i<CACHE_FRAMES; i++){
+		k=&c->kept[i];
+		if(!k->pads || !same_geometry(k,fr,opts))
+			continue;
+		fr->in=k->in;
+		fr->out=k->out;
+		fr->pads=k->pads;
+		fr->cache=c;
+		k->in=k->out=0;
+		k->pads=0;
+		return 1;
+	}
+	return 0;
+}
+
+/* keep the tables of fr, which frames_free() is done with, in c (the
+ * oldest kept making way), returning 1; 0 without a cache */
+int cache_keep_frames(filter_cache *c, frames *fr){
+	int i, slot;
+
+	if(!c || !fr->pads)
+		return 0;
+	slot=0;
+	for(i=0; i<CACHE_FRAMES; i++){
+		if(!c->kept[i].pads){
+			slot=i;
+			break;
+		}
+		if(c->age[i]<c->age[slot])
+			slot=i;
+	}
+	if(c->kept[slot].pads)
+		frames_free(&c->kept[slot]);
+	c->kept[slot]=*fr;
+	c->kept[slot].cache=0;		/* so frames_free() frees it */
+	c->age[slot]=++c->clock;
+	fr->in=fr->out=0;
+	fr->pads=0;
+	return 1;
+}
+
+/* whether tables made for k serve fr (and opts' border) too */
+static int same_geometry(const frames *k, const frames *fr,
+					const filter_options *opts){
+	return k->no_rows==fr->no_rows && k->no_cols==fr->no_cols
+	    && k->no_frames==fr->no_frames && k->r0==fr->r0 && k->r1==fr->r1
+	    && k->c0==fr->c0 && k->c1==fr->c1 && k->win_rows==fr->win_rows
+	    && k->win_cols==fr->win_cols && k->typed==fr->typed
+	    && k->npads==fr->npads && k->pads[0].policy==opts->border
+	    && (opts->border!=BORDER_CONSTANT
+		|| k->pads[0].value==opts->border_value);
+}
@@ -0,0 +1,28 @@
+/* cache.h */
+
+/* what a filter_cache (filters.h) keeps between the calls made with it: the
+ * worker threads, the worker arenas, the spare buffer of iterations and the
+ * row and padding tables of the last few frame geometries. Every function
+ * takes a null cache as "make and free for this call only", so the filters
+ * call them whether or not they were given one */
+
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stddef.h>
+#include "arena.h"
+#include "filters.h"
+#include "frames.h"
+#include "parallel.h"
+
+#define CACHE_FRAMES	4	/* geometries whose tables are kept */
+
+worker_pool *cache_pool(filter_cache*);
+arena *cache_arenas(filter_cache*, int, size_t, size_t*);
+int cache_done_arenas(filter_cache*, arena*, int);
+void *cache_spare(filter_cache*, size_t, filter_stats*);
+void cache_done_spare(filter_cache*, void*);
+int cache_take_frames(filter_cache*, frames*, const filter_options*);
+int cache_keep_frames(filter_cache*, frames*);
+
+#endif
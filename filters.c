@@ -0,0 +1,100 @@
+/* filters.c */
+
+#include <string.h>
+#include "filters.h"
+
+void filter_defaults(filter_options *opts){
+	opts->method[0]=0;
+	opts->threads=0;
+	opts->border=BORDER_MIRROR;
+	opts->border_value=0;
+	opts->window[0]=opts->window[1]=0;
+	opts->sigma[0]=opts->sigma[1]=0;
+	opts->region[0]=opts->region[1]=opts->region[2]=opts->region[3]=0;
+	opts->mask=0;
+	opts->previous=0;
+	opts->iterations=1;
+	opts->tolerance=0;
+	opts->passes=0;
+	opts->stats=0;
+	opts->cache=0;
+	opts->cancel=0;
+}
+
+/* run the filter called name on d (see filters.h) */
+int filter_run(const char *name, const filter_data *d, int ws, int nlook,
+				int damp, const filter_options *opts){
+	if(!strcmp(name,"av2"))
+		return av2_filter(d,ws,opts);
+	if(!strcmp(name,"med2"))
+		return med2_filter(d,ws,opts);
+	if(!strcmp(name,"lee2"))
+		return lee2_filter(d,ws,nlook,opts);
+	if(!strcmp(name,"elee2"))
+		return elee2_filter(d,ws,nlook,damp,opts);
+	return FILTER_ERR_FILTER;
+}
+
+/* what a FILTER_ return code means */
+const char *filter_message(int code){
+	switch(code){
+	case FILTER_OK:		return "no error";
+	case FILTER_ERR_WINDOW:	return "window sizes must be positive integers";
+	case FILTER_ERR_METHOD:	return "method not known to this filter (see its usage)";
+	case FILTER_ERR_HIST:	return "'hist' needs integer values spanning at most 4096 levels";
+	case FILTER_ERR_CLASS:	return "classes must be double, single, uint8, uint16 or int16";
+	case FILTER_ERR_BORDER:	return "border must be 'mirror', 'replicate', 'constant', 'wrap' or a number";
+	case FILTER_ERR_SIZE:	return "dimensions must not be negative";
+	case FILTER_ERR_MEMORY:	return "out of memory";
+	case FILTER_ERR_REGION:	return "region must lie within the matrix";
+	case FILTER_ERR_FILTER:	return "filter must be av2, med2, lee2 or elee2";
+	case FILTER_ERR_FILE:	return "cannot map, read or write a file of that size";
+	case FILTER_ERR_ITERATE:	return "iterations need the whole matrix and a single filter";
+	case FILTER_ERR_CANCELLED:	return "cancelled";
+	case FILTER_ERR_SIGMA:	return "sigma must be 0.5 or more (0 for a third of the window's reach)";
+	case FILTER_ERR_PREVIOUS:	return "previous outputs are kept by single passes of one filter in memory";
+	}
+	return "unknown error";
+}
+
+/* FILTER_ class called name, -1 for none */
+int filter_class_named(const char *name){
+	if(!name[0] || !strcmp(name,"same"))
+		return FILTER_SAME;
+	if(!strcmp(name,"double"))
+		return FILTER_DOUBLE;
+	if(!strcmp(name,"single"))
+		return FILTER_SINGLE;
+	if(!strcmp(name,"uint8"))
+		return FILTER_UINT8;
+	if(!strcmp(name,"uint16"))
+		return FILTER_UINT16;
+	if(!strcmp(name,"int16"))
+		return FILTER_INT16;
+	return -1;
+}
+
+/* BORDER_ policy called name, -1 for none */
+int filter_border_named(const char *name){
+	if(!name[0] || !strcmp(name,"mirror"))
+		return BORDER_MIRROR;
+	if(!strcmp(name,"replicate"))
+		return BORDER_REPLICATE;
+	if(!strcmp(name,"constant"))
+		return BORDER_CONSTANT;
+	if(!strcmp(name,"wrap"))
+		return BORDER_WRAP;
+	return -1;
+}
+
+/* bytes of one element of a FILTER_ class, 0 for FILTER_SAME or none */
+size_t filter_class_size(int cls){
+	switch(cls){
+	case FILTER_DOUBLE:	return sizeof(double);
+	case FILTER_SINGLE:	return sizeof(float);
+	case FILTER_UINT8:	return sizeof(unsigned char);
+	case FILTER_UINT16:	return sizeof(unsigned short);
+	case FILTER_INT16:	return sizeof(short);
+	}
+	return 0;
+}
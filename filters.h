@@ -0,0 +1,219 @@
+/* filters.h */
+
+/* the filters as a plain C library, for C and C++ programs as well as the
+ * mex files. Images are stored as MATLAB stores them, column after column
+ * (a row-major image of H rows and W columns is the column-major W x H
+ * matrix, its windows of h rows and w columns being w x h windows of that
+ * matrix), and a stack is its frames one after the other. Each call returns
+ * FILTER_OK or one of the FILTER_ERR_ codes, which filter_message() puts
+ * into words */
+
+#ifndef FILTERS_H
+#define FILTERS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+
+/* element classes */
+#define FILTER_SAME	0	/* filter_class_named("same") */
+#define FILTER_DOUBLE	1
+#define FILTER_SINGLE	2
+#define FILTER_UINT8	3
+#define FILTER_UINT16	4
+#define FILTER_INT16	5
+
+/* padding of windows reaching past the image */
+#define BORDER_MIRROR		0	/* -1 is 0, n is n-1 (default) */
+#define BORDER_REPLICATE	1	/* the edge value repeated */
+#define BORDER_CONSTANT		2	/* a fixed value */
+#define BORDER_WRAP		3	/* the image repeated periodically */
+
+#define FILTER_OK		0
+#define FILTER_ERR_WINDOW	1	/* window side below 1 */
+#define FILTER_ERR_METHOD	2	/* method the filter does not have */
+#define FILTER_ERR_HIST		3	/* 'hist' on values it cannot bin */
+#define FILTER_ERR_CLASS	4	/* class with no loader */
+#define FILTER_ERR_BORDER	5	/* no such BORDER_ policy */
+#define FILTER_ERR_SIZE		6	/* negative dimension */
+#define FILTER_ERR_MEMORY	7
+#define FILTER_ERR_REGION	8	/* region outside the matrix */
+#define FILTER_ERR_FILTER	9	/* filter_run() of an unknown name */
+#define FILTER_ERR_FILE		10	/* file not read or written */
+#define FILTER_ERR_ITERATE	11	/* iterations of part of a matrix */
+#define FILTER_ERR_PREVIOUS	12	/* previous with iterations, fused or
+					 * streamed */
+#define FILTER_ERR_CANCELLED	13	/* filter_cancel() */
+#define FILTER_ERR_SIGMA	14	/* sigma below GAUSS_MIN_SIGMA */
+
+/* no_frames matrices of no_rows x no_cols, in and out of the given
+ * FILTER_ classes (not FILTER_SAME) */
+typedef struct {
+	int in_class, out_class;
+	const void *in;
+	void *out;
+	int no_rows, no_cols, no_frames;
+} filter_data;
+
+/* where the time of calls went, for filter_options.stats. The filters add
+ * to it, so it totals every call made with it until cleared (memset to 0):
+ * the passes of one call, or the strips of filter_stream() */
+#define FILTER_PHASE_ARGS	0	/* the caller's own (the mex files:
+					 * reading arguments, making outputs) */
+#define FILTER_PHASE_SETUP	1	/* checks, row and padding tables,
+					 * choosing the engine */
+#define FILTER_PHASE_SCRATCH	2	/* worker arenas, spare pass buffer */
+#define FILTER_PHASE_FILTER	3	/* the workers running the tiles */
+#define FILTER_PHASE_FINISH	4	/* freeing, tolerance checks */
+#define FILTER_PHASES		5
+
+typedef struct {
+	double seconds[FILTER_PHASES];	/* wall time of each FILTER_PHASE_ */
+	double pixels;			/* output pixels of every pass */
+	double bytes;			/* tables and scratch allocated */
+	double busy, available;		/* worker seconds spent on tiles, and
+					 * workers times the filter phase */
+	int threads, tiles;		/* workers of the last pass, tiles of
+					 * every pass */
+	char path[64];			/* filter and engine of the last pass,
+					 * as "med2 network" */
+} filter_stats;
+
+/* what calls made with it keep for the next (worker threads, scratch, row
+ * and padding tables), so that a run of calls on frames alike allocates
+ * and starts nothing past the first. For one call at a time; its memory
+ * stays until filter_cache_free() */
+typedef struct filter_cache filter_cache;
+
+/* an earlier call on matrices alike (the same sizes, classes and options),
+ * for filter_options.previous: its output is kept wherever no window reads
+ * a pixel changed since, and only the rest is filtered again (as under a
+ * mask, see filter_options), so a frame of video differing from the last in
+ * small areas costs little. The changes are the nchanged rectangles of
+ * changed, rows changed[4k]..changed[4k+1]-1 and columns
+ * changed[4k+2]..changed[4k+3]-1 of every matrix, or when changed is null
+ * the elements where in differs from the input */
+typedef struct {
+	const void *in;		/* the earlier input, unused with changed */
+	const void *out;	/* its output, laid out as the output */
+	const int *changed;
+	int nchanged;
+} filter_previous;
+
+/* the optional settings, as filter_defaults() leaves them unless set */
+typedef struct {
+	char method[32];	/* engine name, "" for the default */
+	int threads;		/* worker threads, 0 for the default */
+	int border;		/* BORDER_ policy */
+	double border_value;	/* padding value of BORDER_CONSTANT */
+	int window[2];		/* rows and columns of each window, in place
+				 * of the window size argument (square
+				 * windows of that side when both are 0) */
+	double sigma[2];	/* along rows and columns, of the Gaussian of
+				 * method "gauss" (see gauss.h), 0 for a third
+				 * of the window's reach either side */
+	int region[4];		/* rows region[0]..region[1]-1 and columns
+				 * region[2]..region[3]-1 of each matrix are
+				 * filtered, windows still reading the rest,
+				 * and out holds just them (column after
+				 * column); all 0 for the whole matrix */
+	const unsigned char *mask;	/* no_rows x no_cols, laid out as
+				 * each matrix: only pixels where it is not 0
+				 * are filtered, the others copied from the
+				 * input (in the output class), and the time
+				 * taken follows the area selected; null for
+				 * every pixel */
+	const filter_previous *previous;	/* an earlier output to keep
+				 * what it can of, unless null */
+	int iterations;		/* passes, each filtering the result of the
+				 * one before in the output class (default 1) */
+	double tolerance;	/* stop once a pass changes values by less
+				 * than this on average (default 0: never) */
+	int *passes;		/* set to the passes run, unless null */
+	filter_stats *stats;	/* added to, unless null (see filter_stats) */
+	filter_cache *cache;	/* kept between calls, unless null (see
+				 * filter_cache) */
+	const volatile int *cancel;	/* the tiles left are skipped once
+				 * another thread sets it, the output being
+				 * left part filtered, unless null */
+} filter_options;
+
+/* raw files for filter_stream(): no_frames matrices as filter_data has
+ * them, column after column in native byte order, the input starting
+ * offset bytes in (past a header) */
+typedef struct {
+	const char *in, *out;		/* paths */
+	long long offset;
+	int in_class, out_class;	/* out_class may be FILTER_SAME */
+	int no_rows, no_cols, no_frames;
+	int strip;			/* columns filtered at a time, 0 to
+					 * choose */
+} filter_files;
+
+void filter_defaults(filter_options*);
+const char *filter_message(int);
+int filter_class_named(const char*);
+int filter_border_named(const char*);
+size_t filter_class_size(int);
+void filter_stats_text(const filter_stats*, char*, size_t);
+filter_cache *filter_cache_create(void);
+void filter_cache_free(filter_cache*);
+
+/* the filters, with windows of the side given (or opts->window) and opts
+ * being null for the defaults */
+int av2_filter(const filter_data*, int, const filter_options*);
+int med2_filter(const filter_data*, int, const filter_options*);
+int lee2_filter(const filter_data*, int, int, const filter_options*);
+int elee2_filter(const filter_data*, int, int, int, const filter_options*);
+
+/* the outputs of fused_filter(), which makes any of them from one pass:
+ * outs[FUSED_MEAN] .. outs[FUSED_ELEE] of the shape and class d->out would
+ * have (d->out itself unused), null for those not wanted. 'method' is that
+ * of the median */
+#define FUSED_MEAN	0	/* av2_filter(), to rounding */
+#define FUSED_MEDIAN	1	/* med2_filter() */
+#define FUSED_LEE	2	/* lee2_filter() */
+#define FUSED_ELEE	3	/* elee2_filter() */
+#define FUSED_OUTPUTS	4
+
+int fused_filter(const filter_data*, void *const*, int, int, int,
+						const filter_options*);
+
+/* the filter called "av2", "med2", "lee2" or "elee2", ignoring the
+ * arguments it does not take, and the same on files larger than memory */
+int filter_run(const char*, const filter_data*, int, int, int,
+						const filter_options*);
+int filter_stream(const char*, const filter_files*, int, int, int,
+						const filter_options*);
+
+/* a filter taking filter_run()'s arguments (filter_run() itself, or one
+ * calling a single filter so as not to link the others) */
+typedef int (*filter_fn)(const char*, const filter_data*, int, int, int,
+						const filter_options*);
+
+/* a filter_fn on a thread of its own: filter_submit() returns at once with
+ * a job (or FILTER_ERR_MEMORY), which filter_poll() says whether it has
+ * finished, filter_wait() waits for and returns the FILTER_ code of, and
+ * filter_cancel() stops early (the code then being FILTER_ERR_CANCELLED).
+ * d's arrays and what opts points to must stay until the job has finished,
+ * a cache serving one job at a time; filter_job_free() waits for it and
+ * frees it. Jobs run side by side, each on worker threads of its own (or
+ * of its cache), those of all jobs running at once being no more than
+ * parallel_threads(0) would give one call: a job takes what it asks for of
+ * those left, and waits while none are */
+typedef struct filter_job filter_job;
+
+int filter_submit(filter_job**, filter_fn, const char*, const filter_data*,
+				int, int, int, const filter_options*);
+int filter_poll(filter_job*);
+int filter_wait(filter_job*);
+void filter_cancel(filter_job*);
+void filter_job_free(filter_job*);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,566 @@
+/* frames.c */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cache.h"
+#include "frames.h"
+#include "stats.h"
+
+/* rows of the bands a tile is cut into under a mask, for windows of wr
+ * rows: small enough to follow the mask's outline, large enough for the
+ * per call set up of the sliding engines to stay small */
+#define MASK_ROWS(wr)	(4*(wr)>16 ? 4*(wr) : 16)
+
+/* a job run under a mask (see frames_run()) */
+typedef struct {
+	frames *fr;
+	tile_job job;
+	void *arg;
+} masked_job;
+
+/* prototypes */
+static void point_rows(frames*, double**, void*);
+static void masked_tile(void*, int, int, int, int, int, int);
+static double mean_change(const filter_data*, size_t);
+static int changes(frames*, const filter_data*, const filter_options*);
+static void mark(unsigned char*, int, int, int, int);
+static void widen(unsigned char*, unsigned char*, int*, int, int, int, int,
+									int);
+
+/* run pass on d opts->iterations times, each pass filtering the result of
+ * the one before. The passes write to d->out and one spare buffer in turn,
+ * starting with whichever makes the last one land in d->out, so nothing
+ * is copied or reallocated between passes. With a tolerance, stops (the
+ * result copied to d->out if need be) after the first pass whose mean
+ * absolute change is below it; once opts->cancel is set, after the pass
+ * running, returning FILTER_ERR_CANCELLED */
+int frames_iterate(const filter_data *d, frames_pass pass, const int *params,
+						const filter_options *opts){
+	filter_options once;
+	filter_data step;
+	void *spare=0;
+	int n, k, rc=FILTER_OK;
+	size_t count, bytes;
+	double since;
+
+	n=opts->iterations>1 ? opts->iterations : 1;
+	if(opts->passes)
+		*opts->passes=0;
+	once=*opts;
+	once.iterations=1;
+	once.passes=0;
+	if(n>1 && opts->previous)
+		return FILTER_ERR_PREVIOUS;
+	if(n==1){
+		rc=pass(d,params,&once);
+		if(rc==FILTER_OK && opts->cancel && *opts->cancel)
+			return FILTER_ERR_CANCELLED;
+		if(rc==FILTER_OK && opts->passes)
+			*opts->passes=1;
+		return rc;
+	}
+	if(opts->region[0] || opts->region[1] || opts->region[2]
+							|| opts->region[3])
+		return FILTER_ERR_ITERATE;
+	if(d->no_rows<0 || d->no_cols<0 || d->no_frames<0)
+		return FILTER_ERR_SIZE;
+	count=(size_t)d->no_rows*d->no_cols*d->no_frames;
+	bytes=count*filter_class_size(d->out_class);
+	stats_start(opts->stats,&since);
+	spare=cache_spare(opts->cache,bytes,opts->stats);
+	if(!spare)
+		return FILTER_ERR_MEMORY;
+	stats_phase(opts->stats,FILTER_PHASE_SCRATCH,&since);
+
+	step=*d;
+	for(k=1; k<=n; k++){
+		step.out=(n-k)%2==0 ? d->out : spare;
+		rc=pass(&step,params,&once);
+		if(rc!=FILTER_OK)
+			break;
+		if(opts->cancel && *opts->cancel){
+			rc=FILTER_ERR_CANCELLED;
+			break;
+		}
+		if(opts->passes)
+			*opts->passes=k;
+		stats_start(opts->stats,&since);
+		if(k<n && opts->tolerance>0
+		    && mean_change(&step,count)<opts->tolerance){
+			if(step.out!=d->out)
+				memcpy(d->out,step.out,bytes);
+			stats_phase(opts->stats,FILTER_PHASE_FINISH,&since);
+			break;
+		}
+		stats_phase(opts->stats,FILTER_PHASE_FINISH,&since);
+		step.in=step.out;
+		step.in_class=step.out_class;
+	}
+	cache_done_spare(opts->cache,spare);
+	return rc;
+}
+
+/* the window of side ws, or of opts->window when set, in filter rows and
+ * columns (MATLAB's columns and rows, see frames_create()), returning
+ * FILTER_OK or FILTER_ERR_WINDOW */
+int frames_window(int ws, const filter_options *opts, int *win_rows,
+							int *win_cols){
+	if(opts->window[0] || opts->window[1]){
+		*win_rows=opts->window[1];
+		*win_cols=opts->window[0];
+	}
+	else
+		*win_rows=*win_cols=ws;
+	return *win_rows<1 || *win_cols<1 ? FILTER_ERR_WINDOW : FILTER_OK;
+}
+
+/* check d and opts and set up fr for windows of side ws (or opts->window),
+ * returning FILTER_OK (fr then needing frames_free()) or the FILTER_ERR_
+ * code of the problem. Tables that opts->cache kept from a call of the
+ * same geometry are pointed at d rather than made again */
+int frames_create(frames *fr, const filter_data *d, int ws,
+						const filter_options *opts){
+	int f, rc, whole;
+	size_t i, n;
+
+	fr->in=0;
+	fr->out=0;
+	fr->pads=0;
+	fr->npads=0;
+	fr->bytes=0;
+	fr->cache=0;
+	fr->mask=opts->mask;
+	fr->kept=0;
+	fr->given=0;
+	fr->made=0;
+	fr->cancel=opts->cancel;
+	fr->outputs=&fr->image;
+	fr->noutputs=1;
+	rc=frames_window(ws,opts,&fr->win_rows,&fr->win_cols);
+	if(rc!=FILTER_OK)
+		return rc;
+	if(d->no_rows<0 || d->no_cols<0 || d->no_frames<0)
+		return FILTER_ERR_SIZE;
+	if(d->in_class<FILTER_DOUBLE || d->in_class>FILTER_INT16
+	    || d->out_class<FILTER_DOUBLE || d->out_class>FILTER_INT16)
+		return FILTER_ERR_CLASS;
+	if(opts->border<BORDER_MIRROR || opts->border>BORDER_WRAP)
+		return FILTER_ERR_BORDER;
+	whole=!(opts->region[0] || opts->region[1] || opts->region[2]
+							|| opts->region[3]);
+	if(!whole && (opts->region[0]<0 || opts->region[0]>opts->region[1]
+	    || opts->region[1]>d->no_rows || opts->region[2]<0
+	    || opts->region[2]>opts->region[3] || opts->region[3]>d->no_cols))
+		return FILTER_ERR_REGION;
+
+	/*************************************************************************
+	** since MATLAB was originally written in fortran, it treats arrays	**
+	** in a manner similiar to fortran. Thus, in MATLAB, 2-d matrices are	**
+	** stored as 1-d matrices in the following way:				**
+	**									**
+	** (2-d)                   (1-d)					**
+	** 1 2 3								**
+	** 4 5 6	= 	1 4 2 5 3 6					**
+	**									**
+	** which, read row by row, is the transpose of the matrix. Padding is	**
+	** alike along both axes, so filtering the transpose with the		**
+	** transposed window (win_rows being the caller's window columns)	**
+	** gives the transpose of the result: the filters run straight on the	**
+	** caller's arrays, each column being one filter row, and neither	**
+	** array is copied. The frames of a stack follow each other, so the	**
+	** rows of frame f start at in[f*no_rows].				**
+	*************************************************************************/
+	fr->no_rows=d->no_cols;
+	fr->no_cols=d->no_rows;
+	fr->no_frames=d->no_frames;
+	if(fr->no_frames==0){		/* filtered as one empty matrix */
+		fr->no_rows=0;
+		fr->no_frames=1;
+	}
+	/* a region of the caller's rows and columns is a block of filter
+	 * columns and rows, out holding just that block of each frame */
+	fr->r0=whole ? 0 : opts->region[2];
+	fr->r1=whole || !d->no_frames ? fr->no_rows : opts->region[3];
+	fr->c0=whole ? 0 : opts->region[0];
+	fr->c1=whole ? fr->no_cols : opts->region[1];
+	fr->image.in_class=d->in_class;
+	fr->image.out_class=d->out_class;
+	fr->image.in=d->in;
+	fr->image.out=d->out;
+	fr->image.no_rows=fr->no_rows;
+	fr->image.no_cols=fr->no_cols;
+	fr->image.no_frames=fr->no_frames;
+	fr->image.out_r0=fr->r0;
+	fr->image.out_c0=fr->c0;
+	fr->image.out_rows=fr->r1-fr->r0;
+	fr->image.out_cols=fr->c1-fr->c0;
+	/* a constant border would copy every frame (even for a small region),
+	 * staging copies a tile */
+	fr->typed=(d->in_class!=FILTER_DOUBLE || d->out_class!=FILTER_DOUBLE
+			|| (opts->border==BORDER_CONSTANT
+				&& (fr->no_frames>1 || !whole)));
+	fr->npads=fr->typed ? 1 : fr->no_frames;	/* staged frames share
+							 * the maps */
+	if(cache_take_frames(opts->cache,fr,opts)){
+		frames_point(fr,d);
+		rc=changes(fr,d,opts);
+		if(rc!=FILTER_OK)
+			frames_free(fr);
+		return rc;
+	}
+
+	if(!fr->typed){
+		n=(size_t)fr->no_frames*fr->no_rows;
+		fr->in = (double**) malloc (n*sizeof(double*)+1);
+		fr->out=frames_rows(fr,d->out);
+		if(!fr->in || !fr->out){
+			frames_free(fr);
+			return FILTER_ERR_MEMORY;
+		}
+		for(i=0; i<n; i++)
+			fr->in[i]=(double*)d->in+i*fr->no_cols;
+		fr->bytes+=2*n*sizeof(double*);
+	}
+
+	fr->pads = (border*) calloc (fr->npads,sizeof(border));
+	if(!fr->pads){
+		frames_free(fr);
+		return FILTER_ERR_MEMORY;
+	}
+	for(f=0; f<fr->npads; f++){
+		rc=border_create(&fr->pads[f],
+				fr->typed ? 0 : fr->in+(size_t)f*fr->no_rows,
+				fr->no_rows,fr->no_cols,fr->win_rows,
+				fr->win_cols,opts->border,opts->border_value);
+		if(rc!=FILTER_OK){
+			fr->npads=f+1;
+			frames_free(fr);
+			return rc;
+		}
+		fr->bytes+=sizeof(border)+fr->pads[f].bytes;
+	}
+	fr->cache=opts->cache;
+	rc=changes(fr,d,opts);
+	if(rc!=FILTER_OK)
+		frames_free(fr);
+	return rc;
+}
+
+/* the tables of fr, kept from a call alike, onto the arrays of d */
+void frames_point(frames *fr, const filter_data *d){
+	size_t i, n;
+	int f;
+
+	fr->image.in=d->in;
+	fr->image.out=d->out;
+	if(fr->typed)
+		return;
+	n=(size_t)fr->no_frames*fr->no_rows;
+	for(i=0; i<n; i++)
+		fr->in[i]=(double*)d->in+i*fr->no_cols;
+	point_rows(fr,fr->out,d->out);
+	for(f=0; f<fr->npads; f++)
+		border_point(&fr->pads[f],fr->in+(size_t)f*fr->no_rows);
+}
+
+/* the rows of every frame of out, a double output laid out as fr's (the
+ * rows outside the region being null), for the engines to write; null when
+ * out of memory, else to be freed with free() */
+double **frames_rows(frames *fr, void *out){
+	double **rows;
+
+	rows = (double**) calloc ((size_t)fr->no_frames*fr->no_rows+1,
+							sizeof(double*));
+	if(!rows)
+		return 0;
+	point_rows(fr,rows,out);
+	return rows;
+}
+
+/* run job over the tiles of plan, as run_tiles() does, on workers. Under a
+ * mask each tile is cut into bands of rows, the job running on the
+ * smallest block of each band holding every pixel the mask selects (none
+ * when it selects none), and the pixels it does not select are copied from
+ * the input (or the earlier output kept), so the time taken follows the
+ * area selected */
+void frames_run(frames *fr, tile_plan *plan, tile_job job, void *arg,
+						worker_pool *workers){
+	masked_job m;
+
+	plan->cancel=fr->cancel;
+	if(!fr->mask){
+		run_tiles(plan,job,arg,workers);
+		return;
+	}
+	m.fr=fr;
+	m.job=job;
+	m.arg=arg;
+	run_tiles(plan,masked_tile,&m,workers);
+}
+
+/* one tile of frames_run() under a mask (on a worker thread) */
+static void masked_tile(void *arg, int frame, int r0, int r1, int c0, int c1,
+								int worker){
+	masked_job *m=(masked_job*)arg;
+	frames *fr=m->fr;
+	const unsigned char *row;
+	int b0, b1, r, c, k, top, bottom, left, right;
+
+	for(b0=r0; b0<r1; b0=b1){
+		b1=b0+MASK_ROWS(fr->win_rows)<r1 ? b0+MASK_ROWS(fr->win_rows)
+									: r1;
+		top=b1;
+		bottom=b0;
+		left=c1;
+		right=c0;
+		for(r=b0; r<b1; r++){
+			row=fr->mask+(size_t)r*fr->no_cols;
+			for(c=c0; c<c1 && !row[c]; c++)
+				;
+			if(c==c1)
+				continue;
+			if(c<left)
+				left=c;
+			for(c=c1; !row[c-1]; c--)
+				;
+			if(c>right)
+				right=c;
+			if(r<top)
+				top=r;
+			bottom=r+1;
+		}
+		if(top<bottom)
+			m->job(m->arg,frame,top,bottom,left,right,worker);
+		for(k=0; k<fr->noutputs; k++)
+			for(r=b0; r<b1; r++){
+				if(!fr->kept){
+					typed_pass(&fr->outputs[k],fr->mask,
+							frame,r,c0,c1);
+					continue;
+				}
+				typed_keep(&fr->outputs[k],fr->kept,fr->mask,
+							frame,r,c0,c1);
+				if(fr->given)
+					typed_pass(&fr->outputs[k],fr->given,
+							frame,r,c0,c1);
+			}
+	}
+}
+
+/* set the rows of the region in rows, a table of frames_rows(), to out */
+static void point_rows(frames *fr, double **rows, void *out){
+	int f, r, width;
+
+	width=fr->c1-fr->c0;
+	for(f=0; f<fr->no_frames; f++)
+		for(r=fr->r0; r<fr->r1; r++)
+			rows[(size_t)f*fr->no_rows+r]=(double*)out
+				+((size_t)f*(fr->r1-fr->r0)+r-fr->r0)*width-fr->c0;
+}
+
+/* mean of |out-in| over the count elements of d */
+static double mean_change(const filter_data *d, size_t count){
+	double total=0;
+	size_t i;
+
+	if(count==0)
+		return 0;
+	for(i=0; i<count; i++)
+		total+=fabs(typed_element(d->out,d->out_class,i)
+					-typed_element(d->in,d->in_class,i));
+	return total/count;
+}
+
+/* the mask of the pixels opts->previous cannot keep into fr: those whose
+ * windows reach a change (padding taken into account: mirror and replicate
+ * padding is no further from a window than the pixel it copies), and that
+ * opts->mask selects too. Returns FILTER_OK, or the FILTER_ERR_ code of the
+ * problem */
+static int changes(frames *fr, const filter_data *d,
+						const filter_options *opts){
+	const filter_previous *p=opts->previous;
+	const char *a, *b;
+	unsigned char *mask, *across;
+	int *near, k, r, f, pr, pc, wrapped;
+	const int *ch;
+	size_t n, i, j, len, size, at;
+
+	if(!p)
+		return FILTER_OK;
+	if(!p->out || (!p->changed && !p->in) || p->nchanged<0)
+		return FILTER_ERR_PREVIOUS;
+	n=(size_t)fr->no_rows*fr->no_cols;
+	mask = (unsigned char*) calloc (2*n+1,1);
+	near = (int*) malloc (((size_t)fr->no_cols+1)*sizeof(int));
+	if(!mask || !near){
+		free(mask);
+		free(near);
+		return FILTER_ERR_MEMORY;
+	}
+	fr->made=mask;
+	fr->bytes+=2*n;
+	fr->kept=p->out;
+	fr->given=opts->mask;
+	fr->mask=mask;
+	pr=fr->win_rows/2;
+	pc=fr->win_cols/2;
+	wrapped=opts->border==BORDER_WRAP;
+
+	if(p->changed){
+		/* each rectangle (the caller's rows being filter columns)
+		 * widened as it is marked */
+		for(k=0; k<p->nchanged; k++){
+			ch=p->changed+4*k;
+			if(ch[0]<0 || ch[0]>ch[1] || ch[1]>d->no_rows
+			    || ch[2]<0 || ch[2]>ch[3] || ch[3]>d->no_cols){
+				free(near);
+				return FILTER_ERR_REGION;
+			}
+			if(ch[0]==ch[1] || ch[2]==ch[3] || !d->no_frames)
+				continue;
+			for(r=ch[2]-pr; r<ch[3]+pr; r++){
+				if(!wrapped && (r<0 || r>=fr->no_rows))
+					continue;
+				mark(mask+(size_t)((r%fr->no_rows+fr->no_rows)
+						%fr->no_rows)*fr->no_cols,
+					fr->no_cols,ch[0]-pc,ch[1]+pc,wrapped);
+			}
+		}
+	}
+	else{
+		/* the elements differing in any frame, a block at a time
+		 * (most being alike), then widened by the window */
+		size=filter_class_size(d->in_class);
+		a=(const char*)d->in;
+		b=(const char*)p->in;
+		for(f=0; f<d->no_frames; f++)
+			for(i=0; i<n; i+=len){
+				len=n-i<64 ? n-i : 64;
+				at=((size_t)f*n+i)*size;
+				if(!memcmp(a+at,b+at,len*size))
+					continue;
+				for(j=0; j<len; j++)
+					if(memcmp(a+at+j*size,b+at+j*size,size))
+						mask[i+j]=1;
+			}
+		across=mask+n;
+		widen(mask,across,near,fr->no_rows,fr->no_cols,pr,pc,wrapped);
+	}
+	if(opts->mask)
+		for(i=0; i<n; i++)
+			mask[i]&=opts->mask[i]!=0;
+	free(near);
+	return FILTER_OK;
+}
+
+/* set row[c0..c1-1] of a row of n, wrapping around when wrapped, else
+ * clipped to the row */
+static void mark(unsigned char *row, int n, int c0, int c1, int wrapped){
+	if(!wrapped || c1-c0>=n){
+		if(c0<0)
+			c0=0;
+		if(c1>n)
+			c1=n;
+		if(c0<c1)
+			memset(row+c0,1,c1-c0);
+		return;
+	}
+	c1-=c0;				/* now the length */
+	c0=(c0%n+n)%n;
+	if(c0+c1<=n){
+		memset(row+c0,1,c1);
+		return;
+	}
+	memset(row+c0,1,n-c0);
+	memset(row,1,c1-(n-c0));
+}
+
+/* widen the marks of mask (rows x cols) by pr rows and pc columns either
+ * way, going through across (as large, all 0) and near (cols ints),
+ * wrapping around the edges when wrapped. Each pixel is marked when the
+ * nearest mark before or after it is close enough, in a pass each way;
+ * wrapped, the passes start a lap early, else they skip rows far from any
+ * mark */
+static void widen(unsigned char *mask, unsigned char *across, int *near,
+			int rows, int cols, int pr, int pc, int wrapped){
+	const unsigned char *src;
+	unsigned char *dst;
+	int r, c, start, end, lo, hi, last, first=rows, final=-1;
+
+	/* along each row with marks, into across */
+	start=wrapped ? -cols : 0;
+	end=wrapped ? 2*cols : cols;
+	for(r=0; r<rows; r++){
+		src=mask+(size_t)r*cols;
+		if(!memchr(src,1,cols))
+			continue;
+		if(first==rows)
+			first=r;
+		final=r;
+		dst=across+(size_t)r*cols;
+		last=start-pc-1;
+		for(c=start; c<cols; c++){
+			if(src[c<0 ? c+cols : c])
+				last=c;
+			if(c>=0)
+				dst[c]=c-last<=pc;
+		}
+		last=end+pc;
+		for(c=end-1; c>=0; c--){
+			if(src[c>=cols ? c-cols : c])
+				last=c;
+			if(c<cols && last-c<=pc)
+				dst[c]=1;
+		}
+	}
+	if(final<0)
+		return;
+
+	/* along each column, back into mask rows lo..hi-1 (those past them
+	 * having no marks to start with) */
+	lo=wrapped || first-pr<0 ? 0 : first-pr;
+	hi=wrapped || final+pr+1>rows ? rows : final+pr+1;
+	start=wrapped ? -rows : lo;
+	end=wrapped ? 2*rows : hi;
+	for(c=0; c<cols; c++)
+		near[c]=start-pr-1;
+	for(r=start; r<hi; r++){
+		src=across+(size_t)(r<0 ? r+rows : r)*cols;
+		dst=mask+(size_t)(r<0 ? 0 : r)*cols;
+		for(c=0; c<cols; c++){
+			if(src[c])
+				near[c]=r;
+			if(r>=lo)
+				dst[c]=r-near[c]<=pr;
+		}
+	}
+	for(c=0; c<cols; c++)
+		near[c]=end+pr;
+	for(r=end-1; r>=lo; r--){
+		src=across+(size_t)(r>=rows ? r-rows : r)*cols;
+		dst=mask+(size_t)(r<rows ? r : 0)*cols;
+		for(c=0; c<cols; c++){
+			if(src[c])
+				near[c]=r;
+			if(r<hi && near[c]-r<=pr)
+				dst[c]=1;
+		}
+	}
+}
+
+/* free the tables of fr, or hand them to its cache */
+void frames_free(frames *fr){
+	int f;
+
+	free(fr->made); fr->made=0;
+	if(cache_keep_frames(fr->cache,fr))
+		return;
+	if(fr->pads){
+		for(f=0; f<fr->npads; f++)
+			border_free(&fr->pads[f]);
+		free(fr->pads); fr->pads=0;
+	}
+	free(fr->in); fr->in=0;
+	free(fr->out); fr->out=0;
+}
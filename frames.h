@@ -0,0 +1,54 @@
+/* frames.h */
+
+/* the input, output and padding of one filter call, set up before the
+ * workers start and read only by them */
+
+#ifndef FRAMES_H
+#define FRAMES_H
+
+#include "border.h"
+#include "filters.h"
+#include "parallel.h"
+#include "typed.h"
+
+typedef struct {
+	typed_image image;	/* the caller's data, whatever its class */
+	int typed;		/* staged a tile at a time, see typed.h */
+	int no_rows, no_cols, no_frames;	/* of each frame, filter rows
+						 * being the caller's columns */
+	int r0, r1, c0, c1;	/* the rows and columns filtered */
+	int win_rows, win_cols;	/* of each window, in filter rows and
+				 * columns */
+	double **in, **out;	/* rows of every frame, when not typed */
+	border *pads;		/* padding of each frame, or the one all
+				 * frames share when typed */
+	int npads;
+	size_t bytes;		/* allocated for the tables above */
+	filter_cache *cache;	/* where frames_free() keeps them, if not
+				 * null (see cache.h) */
+	const unsigned char *mask;	/* pixels to filter, see frames_run() */
+	const void *kept;	/* opts->previous->out, which the pixels the
+				 * mask leaves out are copied from, or null */
+	const unsigned char *given;	/* opts->mask then, the pixels it
+				 * leaves out copied from the input still */
+	unsigned char *made;	/* the mask made for opts->previous */
+	const volatile int *cancel;	/* opts->cancel */
+	typed_image *outputs;	/* what a mask's pass-through writes: image,
+				 * or more (fused.c) */
+	int noutputs;
+} frames;
+
+/* one filtering of a call, its arguments past the window size in params */
+typedef int (*frames_pass)(const filter_data*, const int*,
+						const filter_options*);
+
+int frames_iterate(const filter_data*, frames_pass, const int*,
+						const filter_options*);
+int frames_window(int, const filter_options*, int*, int*);
+int frames_create(frames*, const filter_data*, int, const filter_options*);
+double **frames_rows(frames*, void*);
+void frames_point(frames*, const filter_data*);
+void frames_run(frames*, tile_plan*, tile_job, void*, worker_pool*);
+void frames_free(frames*);
+
+#endif
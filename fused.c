@@ -0,0 +1,265 @@
+/* fused.c */
+
+/* the mean, median, Lee and enhanced Lee filters of FUSED2_M.c, any of
+ * them from one pass over the image: each tile is staged and padded once,
+ * the local means and variances of moments.c are computed once for the
+ * mean and both Lee filters, and the median engine of med2.c runs on the
+ * same tile */
+
+#include <stdlib.h>
+#include "arena.h"
+#include "border.h"
+#include "cache.h"
+#include "filters.h"
+#include "frames.h"
+#include "med2.h"
+#include "moments.h"
+#include "parallel.h"
+#include "stats.h"
+#include "typed.h"
+#include "weights.h"
+
+/* everything a worker needs to filter one tile */
+typedef struct {
+	border *m_in;			/* each frame and its padding */
+	double **m_out[FUSED_OUTPUTS];	/* rows of every frame, null for the
+					 * outputs not wanted */
+	int wanted[FUSED_OUTPUTS];
+	int no_rows, no_cols;
+	int win_rows, win_cols;		/* window height and width */
+	int nlook, damp;
+	int isa;			/* blend instructions, see weights.h */
+	med2_engine median;
+	arena *arenas;			/* scratch of each worker */
+	typed_image images[FUSED_OUTPUTS];	/* the caller's data, each
+						 * output in its own */
+	int typed;			/* staged a tile at a time, see typed.h */
+} filter_args;
+
+/* prototypes */
+static void filter_tile(void*, int, int, int, int, int, int);
+static size_t scratch_size(filter_args*, tile_plan*);
+static void filter_moments(filter_args*, border*, double***, int, int, int,
+							int, arena*);
+
+/* filter d with windows of side ws (or opts->window) into outs[FUSED_MEAN]
+ * .. outs[FUSED_ELEE] (see filters.h), 'method' choosing the median
+ * engine */
+int fused_filter(const filter_data *d, void *const *outs, int ws, int nlook,
+				int damp, const filter_options *opts){
+	filter_options defaults;
+	filter_args args;
+	filter_data first;
+	tile_plan plan;
+	frames fr;
+	typed_image passed[FUSED_OUTPUTS];	/* the outputs wanted */
+	int rc, k, method, n;
+	size_t scratch;
+	double since;
+
+	if(!opts){
+		filter_defaults(&defaults);
+		opts=&defaults;
+	}
+	stats_start(opts->stats,&since);
+	method=med2_method(opts->method);
+	if(method<0)
+		return FILTER_ERR_METHOD;
+	if(opts->iterations>1)
+		return FILTER_ERR_ITERATE;	/* each result its own chain */
+	if(opts->previous)
+		return FILTER_ERR_PREVIOUS;	/* one earlier output only */
+
+	/* frames are set up on the first output wanted, the others get row
+	 * tables (or typed images) of their own */
+	first=*d;
+	first.out=0;
+	n=0;
+	for(k=0; k<FUSED_OUTPUTS; k++){
+		args.wanted[k]=outs[k]!=0;
+		args.m_out[k]=0;
+		if(args.wanted[k] && !n++)
+			first.out=outs[k];
+	}
+	rc=frames_create(&fr,&first,ws,opts);
+	if(rc!=FILTER_OK)
+		return rc;
+	args.m_in=fr.pads;
+	args.no_rows=fr.no_rows;
+	args.no_cols=fr.no_cols;
+	args.win_rows=fr.win_rows;
+	args.win_cols=fr.win_cols;
+	args.nlook=nlook;
+	args.damp=damp;
+	args.isa=weights_isa();
+	args.typed=fr.typed;
+	fr.outputs=passed;		/* for the pass-through of a mask */
+	fr.noutputs=0;
+	for(k=0; k<FUSED_OUTPUTS; k++){
+		if(!args.wanted[k])
+			continue;
+		args.images[k]=fr.image;
+		args.images[k].out=outs[k];
+		passed[fr.noutputs++]=args.images[k];
+		if(args.typed)
+			continue;
+		args.m_out[k]=outs[k]==first.out ? fr.out : frames_rows(&fr,outs[k]);
+		if(!args.m_out[k])
+			rc=FILTER_ERR_MEMORY;
+	}
+	if(rc==FILTER_OK && args.wanted[FUSED_MEDIAN])
+		rc=med2_engine_init(&args.median,method,&fr);
+
+	if(rc==FILTER_OK && n>0){
+		plan_tiles(&plan,fr.no_frames,fr.r0,fr.r1,fr.c0,fr.c1,
+			fr.win_rows,fr.win_cols,parallel_threads(opts->threads));
+		stats_phase(opts->stats,FILTER_PHASE_SETUP,&since);
+		scratch=scratch_size(&args,&plan);
+		args.arenas=cache_arenas(opts->cache,plan.nworkers,scratch,&fr.bytes);
+		stats_phase(opts->stats,FILTER_PHASE_SCRATCH,&since);
+		if(args.arenas){
+			frames_run(&fr,&plan,filter_tile,&args,
+						cache_pool(opts->cache));
+			stats_phase(opts->stats,FILTER_PHASE_FILTER,&since);
+			stats_pass(opts->stats,&plan,fr.bytes,
+				"fused %s median, %s blend%s",
+				args.wanted[FUSED_MEDIAN]
+				? med2_engine_name(&args.median) : "no",
+				weights_isa_name(args.isa),STATS_STAGED(args.typed));
+			rc=cache_done_arenas(opts->cache,args.arenas,
+								plan.nworkers);
+		}
+		else
+			rc=FILTER_ERR_MEMORY;
+	}
+	if(rc==FILTER_OK && opts->cancel && *opts->cancel)
+		rc=FILTER_ERR_CANCELLED;
+	for(k=0; k<FUSED_OUTPUTS; k++)
+		if(args.m_out[k]!=fr.out)
+			free(args.m_out[k]);
+	frames_free(&fr);
+	stats_phase(opts->stats,FILTER_PHASE_FINISH,&since);
+	return rc;
+}
+
+/* filter one tile (runs on a worker thread, see parallel.h) */
+static void filter_tile(void *arg, int frame, int r0, int r1, int c0, int c1,
+								int worker){
+	filter_args *a=(filter_args*)arg;
+	arena *scratch=&a->arenas[worker];
+	border *in=a->m_in+frame;
+	double **out[FUSED_OUTPUTS];
+	int no_rows=a->no_rows, no_cols=a->no_cols;
+	int k, r, loaded=0;
+	double *block;
+	typed_tile t;
+
+	arena_reset(scratch);
+	if(setjmp(scratch->bail))
+		return;			/* out of memory, see arena.h */
+
+	/* other classes are filtered through a double copy of the tile, and
+	 * a double tile for each output */
+	for(k=0; k<FUSED_OUTPUTS; k++){
+		out[k]=0;
+		if(!a->wanted[k])
+			continue;
+		if(!a->typed){
+			out[k]=a->m_out[k]+(size_t)frame*a->no_rows;
+			continue;
+		}
+		if(!loaded++){
+			typed_load(&a->images[k],a->m_in,&t,frame,r0,r1,c0,c1,
+								scratch);
+			out[k]=t.out;
+			continue;
+		}
+		block = (double*) arena_alloc (scratch,(size_t)t.no_rows
+						*t.no_cols*sizeof(double));
+		out[k] = (double**) arena_alloc (scratch,
+						t.no_rows*sizeof(double*));
+		for(r=0; r<t.no_rows; r++)
+			out[k][r]=block+(size_t)r*t.no_cols;
+	}
+	if(a->typed){
+		in=&t.in;
+		no_rows=t.no_rows;
+		no_cols=t.no_cols;
+		r0=c0=0;
+		r1=t.no_rows;
+		c1=t.no_cols;
+	}
+
+	if(out[FUSED_MEDIAN])
+		med2_tile(&a->median,in,out[FUSED_MEDIAN],no_rows,no_cols,
+						r0,r1,c0,c1,scratch);
+	if(out[FUSED_MEAN] || out[FUSED_LEE] || out[FUSED_ELEE])
+		filter_moments(a,in,out,r0,r1,c0,c1,scratch);
+
+	if(a->typed)
+		for(k=0; k<FUSED_OUTPUTS; k++)
+			if(out[k]){
+				t.out=out[k];
+				typed_store(&a->images[k],&t);
+			}
+}
+
+/* scratch one worker needs for the largest tile */
+static size_t scratch_size(filter_args *a, tile_plan *plan){
+	size_t size=0, tile;
+	int k, n=0;
+
+	for(k=0; k<FUSED_OUTPUTS; k++)
+		n+=a->wanted[k];
+	if(a->wanted[FUSED_MEDIAN])
+		size+=med2_scratch(&a->median,plan->tile_cols);
+	if(a->wanted[FUSED_MEAN] || a->wanted[FUSED_LEE] || a->wanted[FUSED_ELEE])
+		size+=moments_scratch(plan->tile_cols,a->win_cols)
+			+3*ARENA_BYTES(plan->tile_cols*sizeof(double));
+	if(a->typed){
+		tile=(size_t)plan->tile_rows*plan->tile_cols;
+		size+=typed_scratch(plan->tile_rows,plan->tile_cols,
+						a->win_rows,a->win_cols)
+			+(n-1)*(ARENA_BYTES(tile*sizeof(double))
+			+ARENA_BYTES(plan->tile_rows*sizeof(double*)));
+	}
+	return size;
+}
+
+/* perform filtering of output rows r0..r1-1, columns c0..c1-1 from one
+ * pass of local statistics (moments.c), the means being the mean output
+ * and feeding the Lee blends as lee2.c and elee2.c have them */
+static void filter_moments(filter_args *a, border *m_in, double ***m_out,
+			int r0, int r1, int c0, int c1, arena *scratch){
+	int curRow, curCol, centre, dr, dc;
+	double *mean, *var, *Ic, *row, *m;
+	moments mo;
+
+	/* the tap lee() takes as the centre, off centre for even windows */
+	centre=(a->win_rows*a->win_cols-1)/2;
+	dc=centre/a->win_rows-(a->win_cols-1)/2;	/* m_in is the transposed
+							 * MATLAB matrix */
+	dr=centre%a->win_rows-(a->win_rows-1)/2;
+
+	mean = (double*) arena_alloc (scratch,(c1-c0)*sizeof(double));
+	var = (double*) arena_alloc (scratch,(c1-c0)*sizeof(double));
+	Ic = (double*) arena_alloc (scratch,(c1-c0)*sizeof(double));
+
+	moments_init(&mo,scratch,m_in,a->win_rows,a->win_cols,r0,c0,c1);
+	for(curRow=r0; curRow<r1; curRow++){
+		/* the means go straight into the mean output */
+		m=m_out[FUSED_MEAN] ? m_out[FUSED_MEAN][curRow]+c0 : mean;
+		moments_row(&mo,m,var);
+		if(!m_out[FUSED_LEE] && !m_out[FUSED_ELEE])
+			continue;
+		row=m_in->rows[curRow+dr];
+		for(curCol=c0; curCol<c1; curCol++)
+			Ic[curCol-c0]=row[m_in->cols[curCol+dc]];
+		if(m_out[FUSED_LEE])
+			lee_weights(a->isa,Ic,m,var,m_out[FUSED_LEE][curRow]+c0,
+							c1-c0,a->nlook);
+		if(m_out[FUSED_ELEE])
+			elee_weights(a->isa,Ic,m,var,m_out[FUSED_ELEE][curRow]+c0,
+						c1-c0,a->nlook,a->damp);
+	}
+}
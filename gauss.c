@@ -0,0 +1,305 @@
+/* gauss.c */
+
+/* The recursive Gaussian of Deriche ("Recursively implementing the Gaussian
+ * and its derivatives", INRIA research report 1893, 1993), the fourth order
+ * fit. Along each axis a causal pass
+ *
+ *	p[i] = n0 x[i] + n1 x[i-1] + n2 x[i-2] + n3 x[i-3]
+ *		- d1 p[i-1] - d2 p[i-2] - d3 p[i-3] - d4 p[i-4]
+ *
+ * and an anticausal one
+ *
+ *	m[i] = m1 x[i+1] + m2 x[i+2] + m3 x[i+3] + m4 x[i+4]
+ *		- d1 m[i+1] - d2 m[i+2] - d3 m[i+3] - d4 m[i+4]
+ *
+ * are added, their coefficients following from sigma, so a pixel costs
+ * the same whatever its width and the result is within 0.05% of the peak
+ * of a true Gaussian. The tile and its padding are filtered along the rows
+ * first, then down the columns of the tile, a strip of columns a row at a
+ * time so that the loop runs along memory and the strip stays in cache.
+ * Each pass starts from its first value held steady (x[-1] = x[-2] = ...
+ * = x[0], the outputs before it those of that constant), so a constant
+ * stays constant.
+ *
+ * The variance is the smoothed square less the square of the smoothed
+ * value, both taken of values shifted by a level close to the data, as in
+ * moments.c, to keep the squares small */
+
+#include <math.h>
+#include "gauss.h"
+
+#define STRIP	64		/* columns of the column pass at a time */
+
+typedef struct {
+	double n0, n1, n2, n3;		/* causal, of x[i]..x[i-3] */
+	double m1, m2, m3, m4;		/* anticausal, of x[i+1]..x[i+4] */
+	double d1, d2, d3, d4;		/* both, of their own outputs */
+	double hold_p, hold_m;		/* each one's output for a constant 1 */
+} coeffs;
+
+/* prototypes */
+static double sigma_of(double, int);
+static void coefficients(double, coeffs*);
+static void smooth_row(double*, int, double*, const coeffs*);
+static void smooth_cols(double*, int, size_t, int, double*, double*,
+							const coeffs*);
+
+/* the sigmas of windows of win_rows x win_cols into *sigma_r and *sigma_c
+ * (opts->sigma, else a third of the taps before the centre so that the
+ * window reaches three sigma; 0 for an axis of one or two taps, with none
+ * before the centre, which is left as it is), returning FILTER_OK or
+ * FILTER_ERR_SIGMA */
+int gauss_sigmas(const filter_options *opts, int win_rows, int win_cols,
+					double *sigma_r, double *sigma_c){
+	int i;
+
+	for(i=0; i<2; i++)
+		if(opts->sigma[i]!=0 && !(opts->sigma[i]>=GAUSS_MIN_SIGMA))
+			return FILTER_ERR_SIGMA;
+	/* opts->sigma[0] is along MATLAB rows, filter columns */
+	*sigma_r=sigma_of(opts->sigma[1],win_rows);
+	*sigma_c=sigma_of(opts->sigma[0],win_cols);
+	return FILTER_OK;
+}
+
+/* arena space gauss_tile() takes for tiles of up to tile_rows x tile_cols
+ * and windows of win_rows x win_cols, with the variance when var is set */
+size_t gauss_scratch(int tile_rows, int tile_cols, int win_rows, int win_cols,
+								int var){
+	size_t height, width, block;
+
+	height=tile_rows+win_rows-1;
+	width=tile_cols+win_cols-1;
+	block=ARENA_BYTES(height*width*sizeof(double));
+	return (var ? 2*block : block)
+		+ARENA_BYTES(width*sizeof(double))
+		+2*ARENA_BYTES((height+4)*STRIP*sizeof(double));
+}
+
+/* Gaussian weighted mean of output rows r0..r1-1, columns c0..c1-1 into
+ * mean[r-r0][c-c0], and their variance into var likewise unless it is
+ * null, with windows of win_rows x win_cols (the padding) and sigmas of
+ * sigma_r and sigma_c (see gauss_sigmas()) */
+void gauss_tile(border *in, int win_rows, int win_cols, double sigma_r,
+		double sigma_c, int r0, int r1, int c0, int c1, double **mean,
+						double **var, arena *scratch){
+	int r, c, n, height, width, scale_r, scale_c, nr, nc;
+	double *x, *sq, *tmp, *p, *m, *row, *src, *src_sq, shift, m1, m2;
+	int *colmap;
+	size_t at;
+	coeffs kr, kc;
+
+	scale_r=(win_rows-1)/2;		/* taps before the centre, as in
+					 * moments.c */
+	scale_c=(win_cols-1)/2;
+	nr=r1-r0;
+	nc=c1-c0;
+	height=nr+win_rows-1;
+	width=nc+win_cols-1;
+	colmap=in->cols+c0-scale_c;
+	x = (double*) arena_alloc (scratch,(size_t)height*width*sizeof(double));
+	sq=0;
+	if(var)
+		sq = (double*) arena_alloc (scratch,
+				(size_t)height*width*sizeof(double));
+	tmp = (double*) arena_alloc (scratch,width*sizeof(double));
+	p = (double*) arena_alloc (scratch,(size_t)(height+4)*STRIP
+							*sizeof(double));
+	m = (double*) arena_alloc (scratch,(size_t)(height+4)*STRIP
+							*sizeof(double));
+
+	/* the mean of the first row is close enough to the data to keep the
+	 * squares small */
+	row=in->rows[r0-scale_r];
+	shift=0;
+	for(c=0; c<width; c++)
+		shift+=row[colmap[c]];
+	shift/=width;
+
+	/* the tile and its padding, smoothed along the rows */
+	if(sigma_c>0)
+		coefficients(sigma_c,&kc);
+	for(r=0; r<height; r++){
+		row=in->rows[r0-scale_r+r];
+		at=(size_t)r*width;
+		for(c=0; c<width; c++)
+			x[at+c]=row[colmap[c]]-shift;
+		if(sq)
+			for(c=0; c<width; c++)
+				sq[at+c]=x[at+c]*x[at+c];
+		if(sigma_c>0){
+			smooth_row(x+at,width,tmp,&kc);
+			if(sq)
+				smooth_row(sq+at,width,tmp,&kc);
+		}
+	}
+
+	/* then down the columns of the tile */
+	if(sigma_r>0){
+		coefficients(sigma_r,&kr);
+		for(c=0; c<nc; c+=STRIP){
+			n=nc-c<STRIP ? nc-c : STRIP;
+			smooth_cols(x+scale_c+c,height,width,n,p,m,&kr);
+			if(sq)
+				smooth_cols(sq+scale_c+c,height,width,n,p,m,
+									&kr);
+		}
+	}
+
+	for(r=0; r<nr; r++){
+		at=(size_t)(r+scale_r)*width+scale_c;
+		src=x+at;
+		for(c=0; c<nc; c++)
+			mean[r][c]=shift+src[c];
+		if(!var)
+			continue;
+		src_sq=sq+at;
+		for(c=0; c<nc; c++){
+			m1=src[c];
+			m2=src_sq[c]-m1*m1;
+			var[r][c]=m2>0 ? m2 : 0;
+		}
+	}
+}
+
+/* sigma given (0 for the default) for a window side */
+static double sigma_of(double sigma, int side){
+	if(side<3)
+		return 0;
+	if(sigma>0)
+		return sigma;
+	sigma=(side-1)/2/3.0;
+	return sigma<GAUSS_MIN_SIGMA ? GAUSS_MIN_SIGMA : sigma;
+}
+
+/* the recursion of sigma, from Deriche's fit of the Gaussian by
+ * (a0 cos(w0 t) + a1 sin(w0 t)) exp(-b0 t) + (c0 cos(w1 t) + c1 sin(w1 t))
+ * exp(-b1 t), t being the distance over sigma, scaled so that the passes
+ * add to a gain of 1 */
+static void coefficients(double sigma, coeffs *k){
+	const double a0=1.680, a1=3.735, b0=1.783, b1=1.723;
+	const double c0=-0.6803, c1=-0.2598, w0=0.6318, w1=1.997;
+	double cw0, sw0, cw1, sw1, e0, e1, sum_n, sum_m, sum_d, gain;
+
+	cw0=cos(w0/sigma);
+	sw0=sin(w0/sigma);
+	cw1=cos(w1/sigma);
+	sw1=sin(w1/sigma);
+	e0=exp(-b0/sigma);
+	e1=exp(-b1/sigma);
+	k->n0=a0+c0;
+	k->n1=e1*(c1*sw1-(c0+2*a0)*cw1)+e0*(a1*sw0-(2*c0+a0)*cw0);
+	k->n2=2*e0*e1*((a0+c0)*cw1*cw0-a1*cw1*sw0-c1*cw0*sw1)
+						+c0*e0*e0+a0*e1*e1;
+	k->n3=e1*e0*e0*(c1*sw1-c0*cw1)+e0*e1*e1*(a1*sw0-a0*cw0);
+	k->d1=-2*e1*cw1-2*e0*cw0;
+	k->d2=4*cw1*cw0*e0*e1+e1*e1+e0*e0;
+	k->d3=-2*cw0*e0*e1*e1-2*cw1*e1*e0*e0;
+	k->d4=e0*e0*e1*e1;
+	/* the impulse response being symmetric */
+	k->m1=k->n1-k->d1*k->n0;
+	k->m2=k->n2-k->d2*k->n0;
+	k->m3=k->n3-k->d3*k->n0;
+	k->m4=-k->d4*k->n0;
+
+	sum_n=k->n0+k->n1+k->n2+k->n3;
+	sum_m=k->m1+k->m2+k->m3+k->m4;
+	sum_d=1+k->d1+k->d2+k->d3+k->d4;
+	gain=(sum_n+sum_m)/sum_d;
+	k->n0/=gain;
+	k->n1/=gain;
+	k->n2/=gain;
+	k->n3/=gain;
+	k->m1/=gain;
+	k->m2/=gain;
+	k->m3/=gain;
+	k->m4/=gain;
+	k->hold_p=sum_n/gain/sum_d;
+	k->hold_m=sum_m/gain/sum_d;
+}
+
+/* smooth the n values of x in place, p taking the causal pass */
+static void smooth_row(double *x, int n, double *p, const coeffs *k){
+	double x1, x2, x3, x4, y1, y2, y3, y4, y, xi;
+	int i;
+
+	x1=x2=x3=x[0];
+	y1=y2=y3=y4=k->hold_p*x[0];
+	for(i=0; i<n; i++){
+		xi=x[i];
+		y=k->n0*xi+k->n1*x1+k->n2*x2+k->n3*x3
+			-k->d1*y1-k->d2*y2-k->d3*y3-k->d4*y4;
+		p[i]=y;
+		x3=x2;
+		x2=x1;
+		x1=xi;
+		y4=y3;
+		y3=y2;
+		y2=y1;
+		y1=y;
+	}
+	x1=x2=x3=x4=x[n-1];
+	y1=y2=y3=y4=k->hold_m*x[n-1];
+	for(i=n-1; i>=0; i--){
+		xi=x[i];
+		y=k->m1*x1+k->m2*x2+k->m3*x3+k->m4*x4
+			-k->d1*y1-k->d2*y2-k->d3*y3-k->d4*y4;
+		x[i]=p[i]+y;
+		x4=x3;
+		x3=x2;
+		x2=x1;
+		x1=xi;
+		y4=y3;
+		y3=y2;
+		y2=y1;
+		y1=y;
+	}
+}
+
+/* smooth the n (up to STRIP) columns of the rows x n block x (rows stride
+ * apart) down the columns, in place, p and m of (rows+4) x n taking the
+ * passes: p's rows 0..3 and m's rows..rows+3 hold what each has before
+ * the first row and after the last, rows past x being read as its first
+ * and last */
+static void smooth_cols(double *x, int rows, size_t stride, int n, double *p,
+					double *m, const coeffs *k){
+	const double *x0, *x1, *x2, *x3, *x4;
+	double *y, *first, *last;
+	int r, c;
+
+	first=x;
+	last=x+(size_t)(rows-1)*stride;
+	for(r=0; r<4; r++)
+		for(c=0; c<n; c++){
+			p[r*n+c]=k->hold_p*first[c];
+			m[(rows+r)*n+c]=k->hold_m*last[c];
+		}
+
+	for(r=0; r<rows; r++){
+		x0=x+(size_t)r*stride;
+		x1=x+(size_t)(r>=1 ? r-1 : 0)*stride;
+		x2=x+(size_t)(r>=2 ? r-2 : 0)*stride;
+		x3=x+(size_t)(r>=3 ? r-3 : 0)*stride;
+		y=p+(size_t)(r+4)*n;
+		for(c=0; c<n; c++)
+			y[c]=k->n0*x0[c]+k->n1*x1[c]+k->n2*x2[c]+k->n3*x3[c]
+				-k->d1*y[c-n]-k->d2*y[c-2*n]-k->d3*y[c-3*n]
+							-k->d4*y[c-4*n];
+	}
+	for(r=rows-1; r>=0; r--){
+		x1=x+(size_t)(r+1<rows ? r+1 : rows-1)*stride;
+		x2=x+(size_t)(r+2<rows ? r+2 : rows-1)*stride;
+		x3=x+(size_t)(r+3<rows ? r+3 : rows-1)*stride;
+		x4=x+(size_t)(r+4<rows ? r+4 : rows-1)*stride;
+		y=m+(size_t)r*n;
+		for(c=0; c<n; c++)
+			y[c]=k->m1*x1[c]+k->m2*x2[c]+k->m3*x3[c]+k->m4*x4[c]
+				-k->d1*y[c+n]-k->d2*y[c+2*n]-k->d3*y[c+3*n]
+							-k->d4*y[c+4*n];
+	}
+	for(r=0; r<rows; r++){
+		y=x+(size_t)r*stride;
+		for(c=0; c<n; c++)
+			y[c]=p[(size_t)(r+4)*n+c]+m[(size_t)r*n+c];
+	}
+}
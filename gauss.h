@@ -0,0 +1,29 @@
+/* gauss.h */
+
+/* Gaussian weighted local mean and variance of a tile, by the recursive
+ * filter of Deriche: a fourth order pass forward and one back along each
+ * axis, so each pixel costs the same whatever sigma. The recursion starts
+ * at the edge of the padding, half a window out from the tile, so windows
+ * should reach about three sigma either side of the centre. Past the window
+ * the recursion carries what the Gaussian's tail weighs of the rest of the
+ * tile, so results follow the tile grid, which TILE_HEIGHT and TILE_WIDTH
+ * and where the part filtered starts set (parallel.h): never the thread
+ * count, stream strips or rawtiles tiles, which keep the whole image's
+ * grid, while a mask or 'kept' (filtering blocks of tiles) moves them by
+ * about that tail. Safe to use from worker threads */
+
+#ifndef GAUSS_H
+#define GAUSS_H
+
+#include "arena.h"
+#include "border.h"
+#include "filters.h"
+
+#define GAUSS_MIN_SIGMA	0.5	/* the recursion is no Gaussian below it */
+
+int gauss_sigmas(const filter_options*, int, int, double*, double*);
+size_t gauss_scratch(int, int, int, int, int);
+void gauss_tile(border*, int, int, double, double, int, int, int, int,
+						double**, double**, arena*);
+
+#endif
@@ -0,0 +1,324 @@
+/* lee2.c */
+
+/* the Lee filter of LEE2_M.c, which lists its methods */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "arena.h"
+#include "border.h"
+#include "cache.h"
+#include "filters.h"
+#include "frames.h"
+#include "gauss.h"
+#include "moments.h"
+#include "parallel.h"
+#include "stats.h"
+#include "typed.h"
+#include "weights.h"
+
+#define METHOD_DIRECT	0
+#define METHOD_MOMENTS	1
+#define METHOD_GAUSS	2
+
+static const char *method_names[]={"direct", "moments", "gauss"};
+
+/* everything a worker needs to filter one tile */
+typedef struct {
+	border *m_in;			/* each frame and its padding */
+	double **m_out;			/* rows of every frame */
+	int no_rows, no_cols;
+	int win_rows, win_cols;		/* window height and width */
+	int nlook;
+	int method;
+	double sigma_r, sigma_c;	/* of METHOD_GAUSS */
+	int isa;			/* WEIGHTS_ instruction set */
+	arena *arenas;			/* scratch of each worker */
+	typed_image image;		/* the caller's data, whatever its class */
+	int typed;			/* staged a tile at a time, see typed.h */
+} filter_args;
+
+/* prototypes */
+static int filter_pass(const filter_data*, const int*,
+						const filter_options*);
+static void filter_tile(void*, int, int, int, int, int, int);
+static size_t scratch_size(filter_args*, tile_plan*);
+static void filter(border*, double**, int, int, int, int, int,
+					int, int, int, int, arena*);
+static void filter_moments(border*, double**, int, int, int, int, int, int,
+					int, int, int, int, arena*);
+static double fill(border*,double*,int,int,int,int,int,int,int);
+static double lee(double*,int,int);
+static void filter_gauss(border*, double**, int, int, double, double, int, int,
+					int, int, int, int, arena*);
+static int get_method(const char*);
+
+/* filter d with windows of side ws (or opts->window) for nlook looks (see
+ * filters.h) */
+int lee2_filter(const filter_data *d, int ws, int nlook,
+						const filter_options *opts){
+	filter_options defaults;
+	int params[2];
+	
+	if(!opts){
+		filter_defaults(&defaults);
+		opts=&defaults;
+	}
+	params[0]=ws;
+	params[1]=nlook;
+	return frames_iterate(d,filter_pass,params,opts);
+}
+
+/* one pass of lee2_filter(), params holding ws and nlook */
+static int filter_pass(const filter_data *d, const int *params,
+						const filter_options *opts){
+	int ws=params[0], nlook=params[1];
+	filter_args args;
+	tile_plan plan;
+	frames fr;
+	int rc;
+	size_t scratch;
+	double since;
+	
+	stats_start(opts->stats,&since);
+	args.method=get_method(opts->method);
+	if(args.method<0)
+		return FILTER_ERR_METHOD;
+	rc=frames_create(&fr,d,ws,opts);
+	if(rc!=FILTER_OK)
+		return rc;
+	rc=gauss_sigmas(opts,fr.win_rows,fr.win_cols,&args.sigma_r,
+							&args.sigma_c);
+	if(rc!=FILTER_OK){
+		frames_free(&fr);
+		return rc;
+	}
+	args.m_in=fr.pads;
+	args.m_out=fr.out;
+	args.no_rows=fr.no_rows;
+	args.no_cols=fr.no_cols;
+	args.win_rows=fr.win_rows;
+	args.win_cols=fr.win_cols;
+	args.image=fr.image;
+	args.typed=fr.typed;
+	args.nlook=nlook;
+	args.isa=weights_isa();
+	plan_tiles(&plan,fr.no_frames,fr.r0,fr.r1,fr.c0,fr.c1,fr.win_rows,
+				fr.win_cols,parallel_threads(opts->threads));
+	stats_phase(opts->stats,FILTER_PHASE_SETUP,&since);
+	scratch=scratch_size(&args,&plan)
+		+(args.typed ? typed_scratch(plan.tile_rows,plan.tile_cols,
+					fr.win_rows,fr.win_cols) : 0);
+	args.arenas=cache_arenas(opts->cache,plan.nworkers,scratch,&fr.bytes);
+	if(!args.arenas){
+		frames_free(&fr);
+		return FILTER_ERR_MEMORY;
+	}
+	stats_phase(opts->stats,FILTER_PHASE_SCRATCH,&since);
+	frames_run(&fr,&plan,filter_tile,&args,cache_pool(opts->cache));
+	stats_phase(opts->stats,FILTER_PHASE_FILTER,&since);
+	stats_pass(opts->stats,&plan,fr.bytes,
+		"lee2 %s%s%s%s",method_names[args.method],
+		args.method!=METHOD_DIRECT ? " " : "",
+		args.method!=METHOD_DIRECT ? weights_isa_name(args.isa) : "",
+		STATS_STAGED(args.typed));
+	rc=cache_done_arenas(opts->cache,args.arenas,plan.nworkers);
+	frames_free(&fr);
+	stats_phase(opts->stats,FILTER_PHASE_FINISH,&since);
+	return rc;
+}
+
+/* engine named by the 'method' option, -1 for none */
+static int get_method(const char *name){
+	if(!name[0] || !strcmp(name,"moments"))
+		return METHOD_MOMENTS;
+	if(!strcmp(name,"direct"))
+		return METHOD_DIRECT;
+	if(!strcmp(name,"gauss"))
+		return METHOD_GAUSS;
+	return -1;
+}
+
+/* filter one tile (runs on a worker thread, see parallel.h) */
+static void filter_tile(void *arg, int frame, int r0, int r1, int c0, int c1,
+								int worker){
+	filter_args *a=(filter_args*)arg;
+	arena *scratch=&a->arenas[worker];
+	border *in=a->m_in+frame;
+	double **out=a->m_out+(size_t)frame*a->no_rows;
+	int no_rows=a->no_rows, no_cols=a->no_cols;
+	typed_tile t;
+	
+	arena_reset(scratch);
+	if(setjmp(scratch->bail))
+		return;			/* out of memory, see arena.h */
+	
+	/* other classes are filtered through a double copy of the tile */
+	if(a->typed){
+		typed_load(&a->image,a->m_in,&t,frame,r0,r1,c0,c1,scratch);
+		in=&t.in;
+		out=t.out;
+		no_rows=t.no_rows;
+		no_cols=t.no_cols;
+		r0=c0=0;
+		r1=t.no_rows;
+		c1=t.no_cols;
+	}
+	
+	if(a->method==METHOD_MOMENTS)
+		filter_moments(in,out,no_rows,no_cols,a->win_rows,a->win_cols,
+					a->nlook,a->isa,r0,r1,c0,c1,scratch);
+	else if(a->method==METHOD_GAUSS)
+		filter_gauss(in,out,a->win_rows,a->win_cols,a->sigma_r,
+			a->sigma_c,a->nlook,a->isa,r0,r1,c0,c1,scratch);
+	else
+		filter(in,out,no_rows,no_cols,a->win_rows,a->win_cols,
+					a->nlook,r0,r1,c0,c1,scratch);
+	
+	if(a->typed)
+		typed_store(&a->image,&t);
+}
+
+/* scratch one worker needs for the largest tile */
+static size_t scratch_size(filter_args *a, tile_plan *plan){
+	if(a->method==METHOD_MOMENTS)
+		return moments_scratch(plan->tile_cols,a->win_cols)
+			+3*ARENA_BYTES(plan->tile_cols*sizeof(double));
+	if(a->method==METHOD_GAUSS)
+		return gauss_scratch(plan->tile_rows,plan->tile_cols,
+						a->win_rows,a->win_cols,1)
+			+2*ARENA_BYTES(plan->tile_rows*sizeof(double*))
+			+ARENA_BYTES((size_t)2*plan->tile_rows*plan->tile_cols
+							*sizeof(double))
+			+ARENA_BYTES(plan->tile_cols*sizeof(double));
+	return ARENA_BYTES((size_t)a->win_rows*a->win_cols*sizeof(double));
+}
+
+/* perform filtering of output rows r0..r1-1, columns c0..c1-1 */
+static void filter(border *m_in, double **m_out, int no_rows, int no_cols,
+		int win_rows, int win_cols, int nlook, int r0, int r1, int c0,
+						int c1, arena *scratch){
+	int curRow, curCol;
+	int side_r, side_c, scale_r, scale_c;
+	double *kernel_array;		/* the taps of one window */
+	
+	side_r=win_rows;		/* size of kernel sides */
+	side_c=win_cols;
+	scale_r=(int)(side_r-1)/2;	/* "width" of kernel */
+	scale_c=(int)(side_c-1)/2;
+	kernel_array = (double*) arena_alloc (scratch,side_r*side_c*sizeof(double));
+		
+	/* filling output matrix by first filling kernel values and then
+	 * processing these kernel values */
+	for(curRow=r0; curRow<r1; curRow++){
+		for(curCol=c0; curCol<c1; curCol++)		
+			m_out[curRow][curCol]=fill(m_in,kernel_array,curRow,
+				curCol,side_r,side_c,scale_r,scale_c,nlook);
+	}
+}
+
+/* perform filtering of output rows r0..r1-1, columns c0..c1-1 from the local
+ * statistics of moments.c, one row of means, variances and centre values at
+ * a time, blended with instruction set isa (see weights.h) */
+static void filter_moments(border *m_in, double **m_out, int no_rows, int no_cols,
+	int win_rows, int win_cols, int nlook, int isa, int r0, int r1, int c0,
+						int c1, arena *scratch){
+	int curRow, curCol, length, centre, dr, dc;
+	double *mean, *var, *Ic, *row;
+	moments mo;
+	
+	length=win_rows*win_cols;
+	
+	/* the tap lee() takes as the centre, off centre for even windows */
+	centre=(length-1)/2;
+	dc=centre/win_rows-(win_cols-1)/2;	/* m_in is the transposed
+						 * MATLAB matrix */
+	dr=centre%win_rows-(win_rows-1)/2;
+	
+	mean = (double*) arena_alloc (scratch,(c1-c0)*sizeof(double));
+	var = (double*) arena_alloc (scratch,(c1-c0)*sizeof(double));
+	Ic = (double*) arena_alloc (scratch,(c1-c0)*sizeof(double));
+	
+	moments_init(&mo,scratch,m_in,win_rows,win_cols,r0,c0,c1);
+	for(curRow=r0; curRow<r1; curRow++){
+		moments_row(&mo,mean,var);
+		row=m_in->rows[curRow+dr];
+		for(curCol=c0; curCol<c1; curCol++)
+			Ic[curCol-c0]=row[m_in->cols[curCol+dc]];
+		lee_weights(isa,Ic,mean,var,m_out[curRow]+c0,c1-c0,nlook);
+	}
+}
+
+/* perform filtering of output rows r0..r1-1, columns c0..c1-1 from the
+ * Gaussian weighted mean and variance of gauss.c, sigma_r and sigma_c
+ * wide (the windows being their padding), and the centre tap the other
+ * methods take, blended with instruction set isa (see weights.h) */
+static void filter_gauss(border *m_in, double **m_out, int win_rows,
+		int win_cols, double sigma_r, double sigma_c, int nlook,
+		int isa, int r0, int r1, int c0, int c1, arena *scratch){
+	int r, c, nr, nc, centre, dr, dc;
+	double **mean, **var, *block, *Ic, *row;
+	
+	nr=r1-r0;
+	nc=c1-c0;
+	
+	/* the tap lee() takes as the centre, off centre for even windows */
+	centre=(win_rows*win_cols-1)/2;
+	dc=centre/win_rows-(win_cols-1)/2;	/* m_in is the transposed
+						 * MATLAB matrix */
+	dr=centre%win_rows-(win_rows-1)/2;
+	mean = (double**) arena_alloc (scratch,nr*sizeof(double*));
+	var = (double**) arena_alloc (scratch,nr*sizeof(double*));
+	block = (double*) arena_alloc (scratch,(size_t)2*nr*nc*sizeof(double));
+	for(r=0; r<nr; r++){
+		mean[r]=block+(size_t)r*nc;
+		var[r]=block+(size_t)(nr+r)*nc;
+	}
+	Ic = (double*) arena_alloc (scratch,nc*sizeof(double));
+	
+	gauss_tile(m_in,win_rows,win_cols,sigma_r,sigma_c,r0,r1,c0,c1,mean,
+							var,scratch);
+	for(r=r0; r<r1; r++){
+		row=m_in->rows[r+dr];
+		for(c=c0; c<c1; c++)
+			Ic[c-c0]=row[m_in->cols[c+dc]];
+		lee_weights(isa,Ic,mean[r-r0],var[r-r0],m_out[r]+c0,nc,nlook);
+	}
+}
+
+/* "fill" kernel */
+static double fill(border *m_in,double *kernel_array,int curRow,int curCol,
+	int side_r,int side_c,int scale_r,int scale_c,int nlook){
+				
+	int length=side_r*side_c;
+	int r, c, *cols;
+	double retVal, *row;
+		
+	/* filling the kernel_array, the padding coming from the tables of
+	 * border.h */
+	cols=m_in->cols+curCol-scale_c;
+	for(r=0; r<side_r; r++){
+	    	row=m_in->rows[curRow-scale_r+r];
+	    	for(c=0; c<side_c; c++)
+			/* kept in MATLAB row order (m_in is transposed) */
+			kernel_array[(side_r*c)+r]=row[cols[c]];
+	}
+				
+	/* processing the values within the kernel */	
+	retVal = lee(kernel_array,length,nlook);
+	return retVal;
+}
+	
+/* "process" the kernel values */
+static double lee(double* kernel, int length, int nlook){
+	int i;
+	double Im, Ic, total=0;
+	for(i=0; i<length; i++)
+		total+=kernel[i];
+	Im = total/length;
+	total=0;
+	for(i=0; i<length; i++)
+		total+=pow((kernel[i]-Im),2);
+	Ic=kernel[(int)(length-1)/2];
+	return lee_weight(Ic,Im,total/length,nlook);
+}
@@ -0,0 +1,713 @@
+/* med2.c */
+
+/* the median filter of MED2_M.c, which lists its methods */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "arena.h"
+#include "border.h"
+#include "cache.h"
+#include "filters.h"
+#include "frames.h"
+#include "med2.h"
+#include "parallel.h"
+#include "stats.h"
+#include "typed.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP>=2)
+#define NET_SSE2
+#include <emmintrin.h>
+#endif
+
+#define HIST_MAX_BINS	4096	/* widest value range for 'hist' (12-bit) */
+#define SORTED_MIN_WS	5	/* smallest window 'auto' runs 'sorted' on,
+				 * by area for rectangles */
+#define NET_BLOCK	8	/* output pixels 'network' sorts at once */
+#define NET_HIST_WS	7	/* smallest side 'auto' prefers 'hist' on */
+
+/* windows 'network' has a kernel for */
+#define NET_WINDOW(r,c)	((r)==(c) && ((r)==3 || (r)==5 || (r)==7))
+
+/* the window of 'sorted' split in two heaps: lo (max-heap) holds the rank+1
+ * smallest values so its top is the median, hi (min-heap) holds the rest.
+ * The heaps store slot numbers, where[slot] is p for lo[p] and -p-1 for
+ * hi[p] */
+typedef struct {
+	double *val;
+	int *lo, *hi, *where;
+	int nlo, nhi;
+} window_heap;
+
+/* everything a worker needs to filter one tile */
+typedef struct {
+	border *m_in;			/* each frame and its padding */
+	double **m_out;			/* rows of every frame */
+	int no_rows, no_cols;
+	med2_engine engine;
+	arena *arenas;			/* scratch of each worker */
+	typed_image image;		/* the caller's data, whatever its class */
+	int typed;			/* staged a tile at a time, see typed.h */
+} filter_args;
+
+/* prototypes */
+static int filter_pass(const filter_data*, const int*,
+						const filter_options*);
+static void filter_tile(void*, int, int, int, int, int, int);
+static void filter(border*, double**, int, int, int, int, int, int, int,
+							int, arena*);
+static void filter_hist(border*, double**, int, int, int, int, double,
+					int, int, int, int, int, arena*);
+static int hist_range(typed_image*, border*, int, int, double*);
+static int hist_fine_bits(int);
+static void filter_sorted(border*, double**, int, int, int, int, int, int,
+							int, int, arena*);
+static void heap_build(window_heap*, double*);
+static void heap_replace(window_heap*, int, double);
+static void heap_up(window_heap*, int, int);
+static void heap_down(window_heap*, int, int);
+static void net_sort(double*, double*, int);
+static double fill(border*,double*,int,int,int,int,int,int);
+static double median(double*,int);
+
+/* the 'network' engine of each window side it has (see network_kernel.h) */
+#define NET_SORT(a,b,n)	net_sort(a,b,n)
+#define NW		3
+#define NFN(name)	name##_3
+#define NET_PAIRS	{{0,2},{0,1},{1,2}}
+#include "network_kernel.h"
+#undef NW
+#undef NFN
+#undef NET_PAIRS
+#define NW		5
+#define NFN(name)	name##_5
+#define NET_PAIRS	{{0,3},{1,4},{0,2},{1,3},{0,1},{2,4},{1,2},{3,4},{2,3}}
+#include "network_kernel.h"
+#undef NW
+#undef NFN
+#undef NET_PAIRS
+#define NW		7
+#define NFN(name)	name##_7
+#define NET_PAIRS	{{0,6},{2,3},{4,5},{0,2},{1,4},{3,6},{0,1},{2,5}, \
+			{3,4},{1,2},{4,6},{2,3},{4,5},{1,2},{3,4},{5,6}}
+#include "network_kernel.h"
+
+/* filter d with windows of side ws, or opts->window (see filters.h) */
+int med2_filter(const filter_data *d, int ws, const filter_options *opts){
+	filter_options defaults;
+	int params[1];
+	
+	if(!opts){
+		filter_defaults(&defaults);
+		opts=&defaults;
+	}
+	params[0]=ws;
+	return frames_iterate(d,filter_pass,params,opts);
+}
+
+/* one pass of med2_filter(), params holding ws */
+static int filter_pass(const filter_data *d, const int *params,
+						const filter_options *opts){
+	int ws=params[0];
+	filter_args args;
+	tile_plan plan;
+	frames fr;
+	int rc, method;
+	size_t scratch;
+	double since;
+	
+	stats_start(opts->stats,&since);
+	method=med2_method(opts->method);
+	if(method<0)
+		return FILTER_ERR_METHOD;
+	rc=frames_create(&fr,d,ws,opts);
+	if(rc!=FILTER_OK)
+		return rc;
+	args.m_in=fr.pads;
+	args.m_out=fr.out;
+	args.no_rows=fr.no_rows;
+	args.no_cols=fr.no_cols;
+	args.image=fr.image;
+	args.typed=fr.typed;
+	rc=med2_engine_init(&args.engine,method,&fr);
+	if(rc!=FILTER_OK){
+		frames_free(&fr);
+		return rc;
+	}
+	plan_tiles(&plan,fr.no_frames,fr.r0,fr.r1,fr.c0,fr.c1,fr.win_rows,
+				fr.win_cols,parallel_threads(opts->threads));
+	stats_phase(opts->stats,FILTER_PHASE_SETUP,&since);
+	scratch=med2_scratch(&args.engine,plan.tile_cols)
+		+(args.typed ? typed_scratch(plan.tile_rows,plan.tile_cols,
+					fr.win_rows,fr.win_cols) : 0);
+	args.arenas=cache_arenas(opts->cache,plan.nworkers,scratch,&fr.bytes);
+	if(!args.arenas){
+		frames_free(&fr);
+		return FILTER_ERR_MEMORY;
+	}
+	stats_phase(opts->stats,FILTER_PHASE_SCRATCH,&since);
+	frames_run(&fr,&plan,filter_tile,&args,cache_pool(opts->cache));
+	stats_phase(opts->stats,FILTER_PHASE_FILTER,&since);
+	stats_pass(opts->stats,&plan,fr.bytes,
+			"med2 %s%s",med2_engine_name(&args.engine),
+			STATS_STAGED(args.typed));
+	rc=cache_done_arenas(opts->cache,args.arenas,plan.nworkers);
+	frames_free(&fr);
+	stats_phase(opts->stats,FILTER_PHASE_FINISH,&since);
+	return rc;
+}
+
+/* engine named by the 'method' option, -1 for none */
+int med2_method(const char *name){
+	if(!name[0] || !strcmp(name,"auto"))
+		return METHOD_AUTO;
+	if(!strcmp(name,"hist"))
+		return METHOD_HIST;
+	if(!strcmp(name,"sorted"))
+		return METHOD_SORTED;
+	if(!strcmp(name,"network"))
+		return METHOD_NETWORK;
+	if(!strcmp(name,"direct"))
+		return METHOD_DIRECT;
+	return -1;
+}
+
+/* name of the engine e runs, as the 'method' option has it */
+const char *med2_engine_name(med2_engine *e){
+	static const char *names[]={"auto", "direct", "hist", "sorted",
+								"network"};
+	
+	return names[e->method];
+}
+
+/* filter one tile (runs on a worker thread, see parallel.h) */
+static void filter_tile(void *arg, int frame, int r0, int r1, int c0, int c1,
+								int worker){
+	filter_args *a=(filter_args*)arg;
+	arena *scratch=&a->arenas[worker];
+	border *in=a->m_in+frame;
+	double **out=a->m_out+(size_t)frame*a->no_rows;
+	int no_rows=a->no_rows, no_cols=a->no_cols;
+	typed_tile t;
+	
+	arena_reset(scratch);
+	if(setjmp(scratch->bail))
+		return;			/* out of memory, see arena.h */
+	
+	/* other classes are filtered through a double copy of the tile */
+	if(a->typed){
+		typed_load(&a->image,a->m_in,&t,frame,r0,r1,c0,c1,scratch);
+		in=&t.in;
+		out=t.out;
+		no_rows=t.no_rows;
+		no_cols=t.no_cols;
+		r0=c0=0;
+		r1=t.no_rows;
+		c1=t.no_cols;
+	}
+	
+	med2_tile(&a->engine,in,out,no_rows,no_cols,r0,r1,c0,c1,scratch);
+	
+	if(a->typed)
+		typed_store(&a->image,&t);
+}
+
+/* choose the engine of method (a METHOD_ of med2.h) for the windows of fr,
+ * returning FILTER_OK or FILTER_ERR_HIST */
+int med2_engine_init(med2_engine *e, int method, frames *fr){
+	e->win_rows=fr->win_rows;
+	e->win_cols=fr->win_cols;
+	e->nbins=0;
+	e->lo=0;
+	if(method==METHOD_AUTO || method==METHOD_HIST)
+		e->nbins=hist_range(&fr->image,fr->pads,fr->r0,fr->r1,&e->lo);
+	if(method==METHOD_HIST && !e->nbins)
+		return FILTER_ERR_HIST;
+	if(NET_WINDOW(e->win_rows,e->win_cols) && (method==METHOD_NETWORK
+	    || (method==METHOD_AUTO && (!e->nbins || e->win_rows<NET_HIST_WS))))
+		e->method=METHOD_NETWORK;
+	else if(e->nbins)
+		e->method=METHOD_HIST;
+	else if(method==METHOD_SORTED || (method==METHOD_AUTO
+	    && e->win_rows*e->win_cols>=SORTED_MIN_WS*SORTED_MIN_WS))
+		e->method=METHOD_SORTED;
+	else
+		e->method=METHOD_DIRECT;
+	return FILTER_OK;
+}
+
+/* filter output rows r0..r1-1, columns c0..c1-1 of a no_rows x no_cols
+ * image with engine e */
+void med2_tile(med2_engine *e, border *in, double **out, int no_rows,
+		int no_cols, int r0, int r1, int c0, int c1, arena *scratch){
+	if(e->method==METHOD_HIST)
+		filter_hist(in,out,no_rows,no_cols,e->win_rows,e->win_cols,
+				e->lo,e->nbins,r0,r1,c0,c1,scratch);
+	else if(e->method==METHOD_SORTED)
+		filter_sorted(in,out,no_rows,no_cols,e->win_rows,e->win_cols,
+						r0,r1,c0,c1,scratch);
+	else if(e->method==METHOD_NETWORK && e->win_rows==3)
+		filter_network_3(in,out,r0,r1,c0,c1,scratch);
+	else if(e->method==METHOD_NETWORK && e->win_rows==5)
+		filter_network_5(in,out,r0,r1,c0,c1,scratch);
+	else if(e->method==METHOD_NETWORK)
+		filter_network_7(in,out,r0,r1,c0,c1,scratch);
+	else
+		filter(in,out,no_rows,no_cols,e->win_rows,e->win_cols,
+						r0,r1,c0,c1,scratch);
+}
+
+/* scratch one worker needs for tiles up to tile_cols wide, mirroring the
+ * arena_alloc() calls of the engines */
+size_t med2_scratch(med2_engine *e, int tile_cols){
+	size_t width, length, nfine, ncoarse;
+	
+	width=tile_cols+e->win_cols-1;
+	length=(size_t)e->win_rows*e->win_cols;
+	if(e->method==METHOD_HIST){
+		nfine=(size_t)1<<hist_fine_bits(e->nbins);
+		ncoarse=(e->nbins+nfine-1)/nfine;
+		return ARENA_BYTES(width*ncoarse*sizeof(unsigned short))
+			+ARENA_BYTES(width*ncoarse*nfine*sizeof(unsigned short))
+			+2*ARENA_BYTES(ncoarse*sizeof(int))
+			+ARENA_BYTES(ncoarse*nfine*sizeof(int));
+	}
+	if(e->method==METHOD_SORTED)
+		return 2*ARENA_BYTES(length*sizeof(double))
+			+ARENA_BYTES(((length-1)/2+1)*sizeof(int))
+			+ARENA_BYTES((length-(length-1)/2)*sizeof(int))
+			+ARENA_BYTES(length*sizeof(int));
+	if(e->method==METHOD_NETWORK)
+		return ARENA_BYTES(e->win_rows*width*sizeof(double))
+			+ARENA_BYTES(length*NET_BLOCK*sizeof(double));
+	return ARENA_BYTES(length*sizeof(double));
+}
+
+/* perform filtering of output rows r0..r1-1, columns c0..c1-1 */
+static void filter(border *m_in, double **m_out, int no_rows, int no_cols,
+		int win_rows, int win_cols, int r0, int r1, int c0, int c1,
+							arena *scratch){
+	int curRow, curCol;
+	int side_r, side_c, scale_r, scale_c;
+	double *kernel_array;		/* the taps of one window */
+	
+	side_r=win_rows;		/* size of kernel sides */
+	side_c=win_cols;
+	scale_r=(int)(side_r-1)/2;	/* "width" of kernel */
+	scale_c=(int)(side_c-1)/2;
+	kernel_array = (double*) arena_alloc (scratch,side_r*side_c*sizeof(double));
+		
+	/* filling output matrix by first filling kernel values and then
+	 * processing these kernel values */
+	for(curRow=r0; curRow<r1; curRow++){
+		for(curCol=c0; curCol<c1; curCol++)		
+			m_out[curRow][curCol]=fill(m_in,kernel_array,curRow,
+					curCol,side_r,side_c,scale_r,scale_c);
+	}
+}
+
+/* number of histogram bins spanning the values the windows of output rows
+ * r0..r1-1 read, padding included (first bin value returned in lo), or 0
+ * when they hold non-integers, NaN/Inf or more than HIST_MAX_BINS distinct
+ * levels */
+static int hist_range(typed_image *img, border *pad, int r0, int r1,
+								double *lo){
+	double mn, mx;
+	
+	if(!typed_range(img,pad->rowmap,r0-pad->row_pad,r1+pad->row_pad,&mn,&mx))
+		return 0;
+	if(pad->policy==BORDER_CONSTANT){
+		if(pad->value!=floor(pad->value))	/* also rejects NaN */
+			return 0;
+		if(pad->value<mn) mn=pad->value;
+		if(pad->value>mx) mx=pad->value;
+	}
+	if(!(mx-mn<HIST_MAX_BINS))	/* also rejects Inf */
+		return 0;
+	*lo=mn;
+	return (int)(mx-mn)+1;
+}
+
+/* filter_hist() splits nbins into segments of 1<<hist_fine_bits(nbins) */
+static int hist_fine_bits(int nbins){
+	int fbits;
+	
+	for(fbits=0; (1<<(2*fbits))<nbins; fbits++)
+		;
+	return fbits;
+}
+
+/* perform filtering with sliding histograms (Perreault and Hebert): every
+ * column keeps a histogram of its window rows, updated by one removal and
+ * one addition per row, and the window histogram is slid along the row by
+ * adding and removing whole column histograms. Histograms are split into a
+ * coarse and a fine level, only the coarse level is slid at every pixel and
+ * the fine segment holding the median is brought up to date when needed, so
+ * the cost per output pixel does not grow with the window size.
+ * Bins are the values lo .. lo+nbins-1 (see hist_range()) */
+static void filter_hist(border *m_in, double **m_out, int no_rows, int no_cols,
+		int win_rows, int win_cols, double lo, int nbins, int r0, int r1,
+					int c0, int c1, arena *scratch){
+	int curRow, curCol, r, c, x, v, b, f, acc, base, width;
+	int side, scale, reach, scale_r, reach_r, rank;
+	int fbits, nfine, ncoarse, nfull;
+	unsigned short *colc, *colf;	/* column histograms (coarse, fine) */
+	int *colmap;			/* their input columns */
+	int *kerc, *kerf;		/* window histograms (coarse, fine) */
+	int *last;			/* column each fine segment is valid for */
+	unsigned short *hc, *hf;
+	double *row_add, *row_sub;
+	
+	side=win_cols;		/* window columns */
+	scale=(int)(side-1)/2;	/* taps before the centre, as in filter() */
+	reach=side-1-scale;	/* taps after the centre */
+	scale_r=(int)(win_rows-1)/2;	/* the same for the window rows */
+	reach_r=win_rows-1-scale_r;
+	rank=(win_rows*side-1)/2;	/* the element median() returns */
+	
+	/* split the bins into ncoarse segments of nfine */
+	fbits=hist_fine_bits(nbins);
+	nfine=1<<fbits;
+	ncoarse=(nbins+nfine-1)/nfine;
+	nfull=ncoarse*nfine;
+	
+	/* a histogram for every window column c0-scale .. c1+reach-1 */
+	base=c0-scale;
+	width=c1-c0+side-1;
+	colc = (unsigned short*) arena_alloc (scratch,width*ncoarse*sizeof(unsigned short));
+	colf = (unsigned short*) arena_alloc (scratch,width*nfull*sizeof(unsigned short));
+	kerc = (int*) arena_alloc (scratch,ncoarse*sizeof(int));
+	kerf = (int*) arena_alloc (scratch,nfull*sizeof(int));
+	last = (int*) arena_alloc (scratch,ncoarse*sizeof(int));
+	memset(colc,0,width*ncoarse*sizeof(unsigned short));
+	memset(colf,0,width*nfull*sizeof(unsigned short));
+	colmap=m_in->cols+base;
+	
+	/* column histograms for the first row of windows */
+	for(r=r0-scale_r; r<=r0+reach_r; r++){
+		row_add=m_in->rows[r];
+		for(c=0; c<width; c++){
+			v=(int)(row_add[colmap[c]]-lo);
+			colc[c*ncoarse+(v>>fbits)]++;
+			colf[c*nfull+v]++;
+		}
+	}
+	
+	for(curRow=r0; curRow<r1; curRow++){
+		/* slide the column histograms down to the window rows of curRow */
+		if(curRow>r0){
+			row_sub=m_in->rows[curRow-scale_r-1];
+			row_add=m_in->rows[curRow+reach_r];
+			for(c=0; c<width; c++){
+				v=(int)(row_sub[colmap[c]]-lo);
+				colc[c*ncoarse+(v>>fbits)]--;
+				colf[c*nfull+v]--;
+				v=(int)(row_add[colmap[c]]-lo);
+				colc[c*ncoarse+(v>>fbits)]++;
+				colf[c*nfull+v]++;
+			}
+		}
+		
+		/* coarse window histogram for the first column, every fine
+		 * segment is stale */
+		memset(kerc,0,ncoarse*sizeof(int));
+		for(c=0; c<side; c++){
+			hc=colc+c*ncoarse;
+			for(b=0; b<ncoarse; b++)
+				kerc[b]+=hc[b];
+		}
+		for(b=0; b<ncoarse; b++)
+			last[b]=c0-side-1;
+		
+		for(curCol=c0; curCol<c1; curCol++){
+			/* slide the coarse window histogram along the row */
+			if(curCol>c0){
+				hc=colc+(curCol+reach-base)*ncoarse;
+				for(b=0; b<ncoarse; b++)
+					kerc[b]+=hc[b];
+				hc=colc+(curCol-scale-1-base)*ncoarse;
+				for(b=0; b<ncoarse; b++)
+					kerc[b]-=hc[b];
+			}
+			
+			/* coarse segment holding the median */
+			acc=0;
+			for(b=0; acc+kerc[b]<=rank; b++)
+				acc+=kerc[b];
+			
+			/* bring its fine segment up to date, rebuilding it when
+			 * that is cheaper than catching up column by column */
+			if(curCol-last[b]>side){
+				memset(kerf+b*nfine,0,nfine*sizeof(int));
+				for(c=curCol-scale; c<=curCol+reach; c++){
+					hf=colf+(c-base)*nfull+b*nfine;
+					for(f=0; f<nfine; f++)
+						kerf[b*nfine+f]+=hf[f];
+				}
+			}
+			else{
+				for(x=last[b]+1; x<=curCol; x++){
+					hf=colf+(x+reach-base)*nfull+b*nfine;
+					for(f=0; f<nfine; f++)
+						kerf[b*nfine+f]+=hf[f];
+					hf=colf+(x-scale-1-base)*nfull+b*nfine;
+					for(f=0; f<nfine; f++)
+						kerf[b*nfine+f]-=hf[f];
+				}
+			}
+			last[b]=curCol;
+			
+			/* fine bin holding the median */
+			for(f=0; acc+kerf[b*nfine+f]<=rank; f++)
+				acc+=kerf[b*nfine+f];
+			m_out[curRow][curCol]=lo+(b*nfine+f);
+		}
+	}
+}
+
+/* perform filtering with the window kept in two heaps (see window_heap).
+ * Window column x lives in slots (x mod side_c)*side_r .. +side_r-1, so
+ * moving one pixel along the row overwrites the slots of the column leaving
+ * the window with the column entering it, each overwrite costing
+ * O(log length). The heaps are rebuilt at the start of every row. Returns
+ * the same element as the quickselect in median() */
+static void filter_sorted(border *m_in, double **m_out, int no_rows, int no_cols,
+		int win_rows, int win_cols, int r0, int r1, int c0, int c1,
+							arena *scratch){
+	int curRow, curCol, r, mc, x, slot;
+	int side_r, side_c, scale, reach, length;
+	double **rows;			/* input rows of the window */
+	double *copy;			/* heap_build() working copy */
+	window_heap w;
+	
+	side_r=win_rows;	/* size of kernel sides */
+	side_c=win_cols;
+	scale=(int)(side_c-1)/2;	/* taps before the centre, as in
+					 * filter() */
+	reach=side_c-1-scale;	/* taps after the centre */
+	length=side_r*side_c;
+	
+	w.nlo=(length-1)/2+1;
+	w.nhi=length-w.nlo;
+	w.val = (double*) arena_alloc (scratch,length*sizeof(double));
+	w.lo = (int*) arena_alloc (scratch,w.nlo*sizeof(int));
+	w.hi = (int*) arena_alloc (scratch,(w.nhi+1)*sizeof(int));
+	w.where = (int*) arena_alloc (scratch,length*sizeof(int));
+	copy = (double*) arena_alloc (scratch,length*sizeof(double));
+	
+	for(curRow=r0; curRow<r1; curRow++){
+		rows=m_in->rows+curRow-(side_r-1)/2;
+		
+		/* every window column of the first pixel, then the heaps */
+		for(x=c0-scale; x<=c0+reach; x++){
+			mc=m_in->cols[x];
+			slot=((x%side_c+side_c)%side_c)*side_r;
+			for(r=0; r<side_r; r++)
+				w.val[slot+r]=rows[r][mc];
+		}
+		heap_build(&w,copy);
+		m_out[curRow][c0]=w.val[w.lo[0]];
+		
+		/* the column entering the window reuses the slots of the
+		 * column leaving it */
+		for(curCol=c0+1; curCol<c1; curCol++){
+			x=curCol+reach;
+			mc=m_in->cols[x];
+			slot=(x%side_c)*side_r;
+			for(r=0; r<side_r; r++)
+				heap_replace(&w,slot+r,rows[r][mc]);
+			m_out[curRow][curCol]=w.val[w.lo[0]];
+		}
+	}
+}
+
+/* split the slot values between the heaps around their median */
+static void heap_build(window_heap *w, double *scratch){
+	int i, nlo, nhi, length;
+	double med;
+	
+	length=w->nlo+w->nhi;
+	for(i=0; i<length; i++)
+		scratch[i]=w->val[i];
+	med=median(scratch,length);
+	
+	/* smaller values to lo, larger to hi, ties fill lo first */
+	nlo=nhi=0;
+	for(i=0; i<length; i++){
+		if(w->val[i]<med)
+			w->lo[nlo++]=i;
+		else if(w->val[i]>med)
+			w->hi[nhi++]=i;
+	}
+	for(i=0; i<length; i++){
+		if(w->val[i]==med){
+			if(nlo<w->nlo)
+				w->lo[nlo++]=i;
+			else
+				w->hi[nhi++]=i;
+		}
+	}
+	for(i=0; i<nlo; i++)
+		w->where[w->lo[i]]=i;
+	for(i=0; i<nhi; i++)
+		w->where[w->hi[i]]=-i-1;
+	for(i=nlo/2-1; i>=0; i--)
+		heap_down(w,1,i);
+	for(i=nhi/2-1; i>=0; i--)
+		heap_down(w,0,i);
+}
+
+/* overwrite the value of one slot and restore both heaps */
+static void heap_replace(window_heap *w, int slot, double v){
+	int p, top;
+	double old;
+	
+	old=w->val[slot];
+	w->val[slot]=v;
+	p=w->where[slot];
+	if(p>=0){
+		if(v>old) heap_up(w,1,p);
+		else heap_down(w,1,p);
+	}
+	else{
+		if(v<old) heap_up(w,0,-p-1);
+		else heap_down(w,0,-p-1);
+	}
+	
+	/* a single value may now sit on the wrong side, swap the tops */
+	if(w->nhi>0 && w->val[w->lo[0]]>w->val[w->hi[0]]){
+		top=w->lo[0];
+		w->lo[0]=w->hi[0];
+		w->hi[0]=top;
+		w->where[w->lo[0]]=0;
+		w->where[w->hi[0]]=-1;
+		heap_down(w,1,0);
+		heap_down(w,0,0);
+	}
+}
+
+/* "x before y" in lo (max-heap, is_lo set) or hi (min-heap) */
+#define HEAP_BEFORE(is_lo,x,y) ((is_lo) ? (x)>(y) : (x)<(y))
+
+/* move the slot at position p towards the top of its heap */
+static void heap_up(window_heap *w, int is_lo, int p){
+	int *h, parent, slot;
+	
+	h=is_lo ? w->lo : w->hi;
+	slot=h[p];
+	while(p>0){
+		parent=(p-1)/2;
+		if(!HEAP_BEFORE(is_lo,w->val[slot],w->val[h[parent]]))
+			break;
+		h[p]=h[parent];
+		w->where[h[p]]=is_lo ? p : -p-1;
+		p=parent;
+	}
+	h[p]=slot;
+	w->where[slot]=is_lo ? p : -p-1;
+}
+
+/* move the slot at position p towards the bottom of its heap */
+static void heap_down(window_heap *w, int is_lo, int p){
+	int *h, n, child, slot;
+	
+	h=is_lo ? w->lo : w->hi;
+	n=is_lo ? w->nlo : w->nhi;
+	slot=h[p];
+	for(;;){
+		child=2*p+1;
+		if(child>=n)
+			break;
+		if(child+1<n && HEAP_BEFORE(is_lo,w->val[h[child+1]],w->val[h[child]]))
+			child++;
+		if(!HEAP_BEFORE(is_lo,w->val[h[child]],w->val[slot]))
+			break;
+		h[p]=h[child];
+		w->where[h[p]]=is_lo ? p : -p-1;
+		p=child;
+	}
+	h[p]=slot;
+	w->where[slot]=is_lo ? p : -p-1;
+}
+
+/* compare and exchange n pairs, a[i] taking the smaller of a[i] and b[i],
+ * as minimum and maximum instructions two pairs at a time where there are
+ * some (the compiler would compare and branch) */
+static void net_sort(double *a, double *b, int n){
+	int i=0;
+	double x, y;
+#ifdef NET_SSE2
+	__m128d u, v;
+	
+	for(; i+2<=n; i+=2){
+		u=_mm_loadu_pd(a+i);
+		v=_mm_loadu_pd(b+i);
+		_mm_storeu_pd(a+i,_mm_min_pd(u,v));
+		_mm_storeu_pd(b+i,_mm_max_pd(v,u));
+	}
+#endif
+	for(; i<n; i++){
+		x=a[i];
+		y=b[i];
+		a[i]=x<y ? x : y;
+		b[i]=x<y ? y : x;
+	}
+}
+
+/* "fill" kernel */
+static double fill(border *m_in,double *kernel_array,int curRow,int curCol,
+	int side_r,int side_c,int scale_r,int scale_c){
+				
+	int length=side_r*side_c;
+	int r, c, *cols;
+	double retVal, *row;
+		
+	/* filling the kernel_array, the padding coming from the tables of
+	 * border.h */
+	cols=m_in->cols+curCol-scale_c;
+	for(r=0; r<side_r; r++){
+	    	row=m_in->rows[curRow-scale_r+r];
+	    	for(c=0; c<side_c; c++)
+			/* kept in MATLAB row order (m_in is transposed) */
+			kernel_array[(side_r*c)+r]=row[cols[c]];
+	}
+				
+	/* processing the values within the kernel */	
+	retVal = median(kernel_array,length);
+	return retVal;
+}
+	
+#define ELEM_SWAP(a,b) { double temp =(a); (a)=(b); (b)=temp; }
+
+/* "process" the kernel values with quickselect routine */
+static double median(double* kernel, int length){
+        int low, high;
+        int median;
+        int middle, ll, hh;
+
+        low=0; high=length-1; median=((low+high)/2);
+        for(;;) {
+                if(high <= low) return kernel[median];
+                if(high == low+1) {
+                        if(kernel[low] > kernel[high])
+                                ELEM_SWAP(kernel[low],kernel[high]);
+                        return kernel[median];
+                }
+                middle = (low+high)/2;
+                if(kernel[middle] > kernel[high]) ELEM_SWAP(kernel[middle],kernel[high]);
+                if(kernel[low] > kernel[high]) ELEM_SWAP(kernel[low],kernel[high]);
+		if(kernel[middle] > kernel[low]) ELEM_SWAP(kernel[middle],kernel[low]);
+                ELEM_SWAP(kernel[middle],kernel[low+1]);
+                ll=low+1;
+                hh=high;
+                for(;;) {
+                        do ll++; while (kernel[low] > kernel[ll]);
+                        do hh--; while (kernel[hh] > kernel[low]);
+                        if(hh < ll) break;
+                        ELEM_SWAP(kernel[ll],kernel[hh]);
+                }
+                ELEM_SWAP(kernel[low],kernel[hh]);
+                if(hh <= median) low=ll;
+                if(hh >= median) high=hh-1;
+        }
+}
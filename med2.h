@@ -0,0 +1,34 @@
+/* med2.h */
+
+/* the median engines of med2.c, for filters giving a median next to other
+ * outputs of the same windows (see fused.c). An engine is chosen before
+ * the workers start and run by them on one tile at a time */
+
+#ifndef MED2_H
+#define MED2_H
+
+#include "arena.h"
+#include "border.h"
+#include "frames.h"
+
+#define METHOD_AUTO	0
+#define METHOD_DIRECT	1
+#define METHOD_HIST	2
+#define METHOD_SORTED	3
+#define METHOD_NETWORK	4
+
+typedef struct {
+	int method;		/* never METHOD_AUTO */
+	int win_rows, win_cols;	/* window height and width */
+	double lo;		/* histogram range, see hist_range() */
+	int nbins;
+} med2_engine;
+
+int med2_method(const char*);
+const char *med2_engine_name(med2_engine*);
+int med2_engine_init(med2_engine*, int, frames*);
+size_t med2_scratch(med2_engine*, int);
+void med2_tile(med2_engine*, border*, double**, int, int, int, int, int, int,
+								arena*);
+
+#endif
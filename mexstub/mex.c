@@ -0,0 +1,257 @@
+/* mex.c */
+
+/* the parts of the MATLAB API mex.h declares, over plain malloc'ed arrays.
+ * Numeric arrays hold their elements in MATLAB order, strings as C
+ * strings */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mex.h"
+
+#define MAX_DIMS	32
+
+struct mxArray_tag {
+	mxClassID cls;
+	mwSize ndims;
+	mwSize dims[MAX_DIMS];
+	void *data;
+};
+
+/* prototypes */
+static mxArray *new_array(mxClassID, mwSize, const mwSize*, size_t);
+static size_t class_size(mxClassID);
+
+void mexErrMsgTxt(const char *msg){
+	fprintf(stderr,"error: %s\n",msg);
+	exit(1);
+}
+
+void mexPrintf(const char *format, ...){
+	va_list args;
+
+	va_start(args,format);
+	vprintf(format,args);
+	va_end(args);
+}
+
+void mexLock(void){
+}
+
+void mexUnlock(void){
+}
+
+/* run at the program's exit, standing in for the mex file being cleared */
+int mexAtExit(void (*fn)(void)){
+	return atexit(fn);
+}
+
+void *mxMalloc(size_t n){
+	void *p;
+
+	p=malloc(n ? n : 1);
+	if(!p)
+		mexErrMsgTxt("out of memory");
+	return p;
+}
+
+void *mxCalloc(size_t n, size_t size){
+	void *p;
+
+	p=calloc(n ? n : 1,size ? size : 1);
+	if(!p)
+		mexErrMsgTxt("out of memory");
+	return p;
+}
+
+void mxFree(void *p){
+	free(p);
+}
+
+mxArray *mxCreateNumericArray(mwSize ndims, const mwSize *dims, mxClassID cls,
+						mxComplexity complexity){
+	if(complexity!=mxREAL || !class_size(cls))
+		mexErrMsgTxt("mex stand-in: only real numeric arrays");
+	return new_array(cls,ndims,dims,class_size(cls));
+}
+
+mxArray *mxCreateNumericMatrix(mwSize m, mwSize n, mxClassID cls,
+						mxComplexity complexity){
+	mwSize dims[2];
+
+	dims[0]=m;
+	dims[1]=n;
+	return mxCreateNumericArray(2,dims,cls,complexity);
+}
+
+mxArray *mxCreateDoubleMatrix(mwSize m, mwSize n, mxComplexity complexity){
+	return mxCreateNumericMatrix(m,n,mxDOUBLE_CLASS,complexity);
+}
+
+mxArray *mxCreateDoubleScalar(double value){
+	mxArray *a;
+
+	a=mxCreateDoubleMatrix(1,1,mxREAL);
+	*(double*)a->data=value;
+	return a;
+}
+
+mxArray *mxCreateString(const char *s){
+	mwSize dims[2];
+	mxArray *a;
+
+	dims[0]=1;
+	dims[1]=strlen(s);
+	a=new_array(mxCHAR_CLASS,2,dims,1);
+	memcpy(a->data,s,dims[1]+1);
+	return a;
+}
+
+void mxDestroyArray(mxArray *a){
+	if(a){
+		free(a->data);
+		free(a);
+	}
+}
+
+mxClassID mxGetClassID(const mxArray *a){
+	return a->cls;
+}
+
+int mxIsClass(const mxArray *a, const char *name){
+	static const char *names[]={
+		"unknown", "cell", "struct", "logical", "char", "void",
+		"double", "single", "int8", "uint8", "int16", "uint16",
+		"int32", "uint32", "int64", "uint64"
+	};
+
+	return !strcmp(names[a->cls],name);
+}
+
+int mxIsChar(const mxArray *a){
+	return a->cls==mxCHAR_CLASS;
+}
+
+int mxIsLogical(const mxArray *a){
+	return a->cls==mxLOGICAL_CLASS;
+}
+
+int mxIsComplex(const mxArray *a){
+	return 0;
+}
+
+mwSize mxGetNumberOfDimensions(const mxArray *a){
+	return a->ndims;
+}
+
+const mwSize *mxGetDimensions(const mxArray *a){
+	return a->dims;
+}
+
+mwSize mxGetM(const mxArray *a){
+	return a->dims[0];
+}
+
+/* the product of every dimension past the first, as in MATLAB */
+mwSize mxGetN(const mxArray *a){
+	mwSize i, n=1;
+
+	for(i=1; i<a->ndims; i++)
+		n*=a->dims[i];
+	return n;
+}
+
+mwSize mxGetNumberOfElements(const mxArray *a){
+	mwSize i, n=1;
+
+	for(i=0; i<a->ndims; i++)
+		n*=a->dims[i];
+	return n;
+}
+
+mwSize mxGetElementSize(const mxArray *a){
+	return a->cls==mxCHAR_CLASS ? 1 : class_size(a->cls);
+}
+
+void *mxGetData(const mxArray *a){
+	return a->data;
+}
+
+double *mxGetPr(const mxArray *a){
+	return (double*)a->data;
+}
+
+/* the first element as a double */
+double mxGetScalar(const mxArray *a){
+	if(!mxGetNumberOfElements(a))
+		return 0;
+	switch(a->cls){
+	case mxDOUBLE_CLASS:	return *(double*)a->data;
+	case mxSINGLE_CLASS:	return *(float*)a->data;
+	case mxINT8_CLASS:	return *(signed char*)a->data;
+	case mxUINT8_CLASS:	return *(unsigned char*)a->data;
+	case mxLOGICAL_CLASS:	return *(unsigned char*)a->data;
+	case mxINT16_CLASS:	return *(short*)a->data;
+	case mxUINT16_CLASS:	return *(unsigned short*)a->data;
+	case mxINT32_CLASS:	return *(int*)a->data;
+	case mxUINT32_CLASS:	return *(unsigned int*)a->data;
+	case mxINT64_CLASS:	return (double)*(long long*)a->data;
+	case mxUINT64_CLASS:	return (double)*(unsigned long long*)a->data;
+	case mxCHAR_CLASS:	return *(char*)a->data;
+	default:		return 0;
+	}
+}
+
+/* copy a string into buf of n bytes, 1 when it is not a string or did not
+ * fit */
+int mxGetString(const mxArray *a, char *buf, mwSize n){
+	size_t len;
+
+	if(!n)
+		return 1;
+	buf[0]=0;
+	if(a->cls!=mxCHAR_CLASS)
+		return 1;
+	len=strlen((char*)a->data);
+	strncpy(buf,(char*)a->data,n-1);
+	buf[n-1]=0;
+	return len>=n;
+}
+
+static mxArray *new_array(mxClassID cls, mwSize ndims, const mwSize *dims,
+							size_t size){
+	mxArray *a;
+	mwSize i, n=1;
+
+	if(ndims>MAX_DIMS)
+		mexErrMsgTxt("mex stand-in: too many dimensions");
+	a=(mxArray*)mxCalloc(1,sizeof(mxArray));
+	a->cls=cls;
+	a->ndims=ndims<2 ? 2 : ndims;
+	a->dims[0]=a->dims[1]=ndims<1 ? 0 : 1;
+	for(i=0; i<ndims; i++){
+		a->dims[i]=dims[i];
+		n*=dims[i];
+	}
+	/* trailing singleton dimensions dropped, as MATLAB does */
+	while(a->ndims>2 && a->dims[a->ndims-1]==1)
+		a->ndims--;
+	a->data=mxCalloc(n+1,size);
+	return a;
+}
+
+static size_t class_size(mxClassID cls){
+	switch(cls){
+	case mxDOUBLE_CLASS: case mxINT64_CLASS: case mxUINT64_CLASS:
+		return 8;
+	case mxSINGLE_CLASS: case mxINT32_CLASS: case mxUINT32_CLASS:
+		return 4;
+	case mxINT16_CLASS: case mxUINT16_CLASS:
+		return 2;
+	case mxINT8_CLASS: case mxUINT8_CLASS: case mxLOGICAL_CLASS:
+		return 1;
+	default:
+		return 0;
+	}
+}
@@ -0,0 +1,61 @@
+/* mex.h */
+
+/* a stand-in for MATLAB's mex.h, just large enough for the mex files of
+ * this directory's parent to build and run as plain programs (see
+ * mexrun.c). Build with -Imexstub, never alongside MATLAB's own */
+
+#ifndef MEX_H
+#define MEX_H
+
+#include <stddef.h>
+
+typedef size_t mwSize;
+
+typedef enum {
+	mxUNKNOWN_CLASS, mxCELL_CLASS, mxSTRUCT_CLASS, mxLOGICAL_CLASS,
+	mxCHAR_CLASS, mxVOID_CLASS, mxDOUBLE_CLASS, mxSINGLE_CLASS,
+	mxINT8_CLASS, mxUINT8_CLASS, mxINT16_CLASS, mxUINT16_CLASS,
+	mxINT32_CLASS, mxUINT32_CLASS, mxINT64_CLASS, mxUINT64_CLASS
+} mxClassID;
+
+typedef enum { mxREAL, mxCOMPLEX } mxComplexity;
+
+typedef struct mxArray_tag mxArray;
+
+/* errors print and exit, there being no MATLAB prompt to return to */
+void mexErrMsgTxt(const char*);
+void mexPrintf(const char*, ...);
+void mexLock(void);
+void mexUnlock(void);
+int mexAtExit(void (*)(void));
+
+void *mxMalloc(size_t);
+void *mxCalloc(size_t, size_t);
+void mxFree(void*);
+
+mxArray *mxCreateNumericArray(mwSize, const mwSize*, mxClassID, mxComplexity);
+mxArray *mxCreateNumericMatrix(mwSize, mwSize, mxClassID, mxComplexity);
+mxArray *mxCreateDoubleMatrix(mwSize, mwSize, mxComplexity);
+mxArray *mxCreateDoubleScalar(double);
+mxArray *mxCreateString(const char*);
+void mxDestroyArray(mxArray*);
+
+mxClassID mxGetClassID(const mxArray*);
+int mxIsClass(const mxArray*, const char*);
+int mxIsChar(const mxArray*);
+int mxIsLogical(const mxArray*);
+int mxIsComplex(const mxArray*);
+mwSize mxGetNumberOfDimensions(const mxArray*);
+const mwSize *mxGetDimensions(const mxArray*);
+mwSize mxGetM(const mxArray*);
+mwSize mxGetN(const mxArray*);
+mwSize mxGetNumberOfElements(const mxArray*);
+mwSize mxGetElementSize(const mxArray*);
+void *mxGetData(const mxArray*);
+double *mxGetPr(const mxArray*);
+double mxGetScalar(const mxArray*);
+int mxGetString(const mxArray*, char*, mwSize);
+
+void mexFunction(int, mxArray*[], int, const mxArray*[]);
+
+#endif
@@ -0,0 +1,126 @@
+/* mexrun.c */
+
+/* USAGE: NAME in.raw out.raw[,out2.raw...] class MxN[xK...] [arg ...]
+ *
+ * runs the mexFunction it is linked with (see the Makefile) as MATLAB would
+ * on NAME(in,arg,...): in is read from in.raw as a class array of the given
+ * dimensions (MATLAB order, the first varying fastest), each arg is passed
+ * as a double when it reads as a number, as a row of doubles when it is
+ * numbers in brackets ("[3 11]") and as a string otherwise, and
+ * the output is written to out.raw in its own class. out.raw may list
+ * several files, separated by commas, for as many outputs */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mex.h"
+
+#define MAX_ARGS	32
+#define MAX_OUTS	8
+
+static mxClassID class_named(const char*);
+static mxArray *row_named(const char*);
+
+int main(int argc, char **argv){
+	const mxArray *prhs[MAX_ARGS];
+	mxArray *plhs[MAX_OUTS], *in;
+	mwSize dims[8], ndims=0;
+	size_t bytes;
+	double value;
+	char *p, *end, *outs[MAX_OUTS];
+	FILE *f;
+	int i, nrhs, nlhs;
+
+	if(argc<5 || argc-4>MAX_ARGS){
+		fprintf(stderr,"usage: %s in.raw out.raw[,out2.raw...] class MxN[xK...] [arg ...]\n",
+								argv[0]);
+		return 2;
+	}
+	for(p=argv[4]; ndims<8; p=end+1){
+		dims[ndims++]=strtoul(p,&end,10);
+		if(*end!='x')
+			break;
+	}
+	in=mxCreateNumericArray(ndims,dims,class_named(argv[3]),mxREAL);
+
+	bytes=mxGetNumberOfElements(in)*mxGetElementSize(in);
+	f=fopen(argv[1],"rb");
+	if(!f || fread(mxGetData(in),1,bytes,f)!=bytes)
+		mexErrMsgTxt("cannot read the input file");
+	fclose(f);
+
+	nrhs=0;
+	prhs[nrhs++]=in;
+	for(i=5; i<argc; i++){
+		value=strtod(argv[i],&end);
+		if(end!=argv[i] && !*end)
+			prhs[nrhs++]=mxCreateDoubleScalar(value);
+		else if(argv[i][0]=='[')
+			prhs[nrhs++]=row_named(argv[i]);
+		else
+			prhs[nrhs++]=mxCreateString(argv[i]);
+	}
+	nlhs=0;
+	for(p=strtok(argv[2],","); p && nlhs<MAX_OUTS; p=strtok(0,","))
+		outs[nlhs++]=p;
+	for(i=0; i<nlhs; i++)
+		plhs[i]=0;
+	mexFunction(nlhs,plhs,nrhs,prhs);
+
+	for(i=0; i<nlhs; i++){
+		bytes=mxGetNumberOfElements(plhs[i])*mxGetElementSize(plhs[i]);
+		f=fopen(outs[i],"wb");
+		if(!f || fwrite(mxGetData(plhs[i]),1,bytes,f)!=bytes
+		    || fclose(f)!=0)
+			mexErrMsgTxt("cannot write the output file");
+		mxDestroyArray(plhs[i]);
+	}
+	for(i=0; i<nrhs; i++)
+		mxDestroyArray((mxArray*)prhs[i]);
+	return 0;
+}
+
+static mxClassID class_named(const char *name){
+	if(!strcmp(name,"double"))
+		return mxDOUBLE_CLASS;
+	if(!strcmp(name,"single"))
+		return mxSINGLE_CLASS;
+	if(!strcmp(name,"uint8"))
+		return mxUINT8_CLASS;
+	if(!strcmp(name,"uint16"))
+		return mxUINT16_CLASS;
+	if(!strcmp(name,"int16"))
+		return mxINT16_CLASS;
+	if(!strcmp(name,"int8"))
+		return mxINT8_CLASS;
+	if(!strcmp(name,"int32"))
+		return mxINT32_CLASS;
+	if(!strcmp(name,"uint32"))
+		return mxUINT32_CLASS;
+	mexErrMsgTxt("class must be double, single or an integer class");
+	return mxUNKNOWN_CLASS;
+}
+
+/* the row vector of the numbers between the brackets of s */
+static mxArray *row_named(const char *s){
+	mxArray *a;
+	double values[MAX_ARGS];
+	const char *p;
+	char *end;
+	int i, n=0;
+
+	for(p=s+1; n<MAX_ARGS; p=end){
+		while(*p==' ' || *p==',')
+			p++;
+		values[n]=strtod(p,&end);
+		if(end==p)
+			break;
+		n++;
+	}
+	if(*p!=']')
+		mexErrMsgTxt("numbers in brackets must be separated by spaces or commas");
+	a=mxCreateDoubleMatrix(1,n,mxREAL);
+	for(i=0; i<n; i++)
+		mxGetPr(a)[i]=values[i];
+	return a;
+}
@@ -0,0 +1,200 @@
+/* moments.c */
+
+/* Local mean and variance from running sums. Every input column keeps the
+ * sum and the sum of squares of its window rows, slid down one row at a time,
+ * and the window totals are slid along the output row, so each pixel costs a
+ * fixed number of additions whatever the window size.
+ *
+ * Running sums of squares lose precision quickly on large, high dynamic
+ * range scenes, so values are shifted by a reference level close to the data
+ * before squaring and every running sum carries a Neumaier compensation term
+ * that keeps the rounding error from accumulating as values enter and leave
+ * the window.
+ *
+ * A NaN or infinite value would stay in the sums after leaving the window
+ * (NaN-NaN and Inf-Inf being NaN), so a sum that is not finite is added up
+ * again from its values, and windows whose totals still are not get their
+ * mean and variance as lee2.c's and elee2.c's 'direct' method has them. */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "moments.h"
+
+/* prototypes */
+static void column_sums(moments*, int);
+static void window_moments(moments*, int, double*, double*);
+static void neumaier(double*, double*, double);
+
+/* arena space moments_init() takes for up to ncols output columns and
+ * windows of win_cols columns */
+size_t moments_scratch(int ncols, int win_cols){
+	size_t width=ncols+win_cols-1;
+	
+	return 4*ARENA_BYTES(width*sizeof(double));
+}
+
+/* prepare the column sums for the win_rows x win_cols windows of output
+ * row first_row, columns c0..c1-1, in arena space */
+void moments_init(moments *m, arena *scratch, border *in, int win_rows,
+			int win_cols, int first_row, int c0, int c1){
+	int r, c, width, n;
+	double *row, x;
+	
+	m->in=in;
+	m->rows=win_rows;
+	m->cols=win_cols;
+	m->scale=(int)(win_rows-1)/2;	/* taps before the centre */
+	m->reach=win_rows-1-m->scale;	/* taps after the centre */
+	m->row=first_row;
+	m->slide=0;
+	
+	/* sums for every window column from c0 less the taps before the
+	 * centre to c1-1 plus those after it */
+	width=c1-c0+win_cols-1;
+	m->c0=c0;
+	m->width=width;
+	m->sum=(double*)arena_alloc(scratch,width*sizeof(double));
+	m->sum_c=(double*)arena_alloc(scratch,width*sizeof(double));
+	m->sq=(double*)arena_alloc(scratch,width*sizeof(double));
+	m->sq_c=(double*)arena_alloc(scratch,width*sizeof(double));
+	m->colmap=in->cols+c0-(win_cols-1)/2;
+	
+	/* the mean of the first row is close enough to the data to keep
+	 * the squares small (of its finite values, so that one NaN does not
+	 * make every value NaN) */
+	row=in->rows[first_row];
+	m->shift=0;
+	for(c=0, n=0; c<width; c++){
+		x=row[m->colmap[c]];
+		if(isfinite(x)){
+			m->shift+=x;
+			n++;
+		}
+	}
+	m->shift=n ? m->shift/n : 0;
+	
+	memset(m->sum,0,width*sizeof(double));
+	memset(m->sum_c,0,width*sizeof(double));
+	memset(m->sq,0,width*sizeof(double));
+	memset(m->sq_c,0,width*sizeof(double));
+	for(r=first_row-m->scale; r<=first_row+m->reach; r++){
+		row=in->rows[r];
+		for(c=0; c<width; c++){
+			x=row[m->colmap[c]]-m->shift;
+			neumaier(&m->sum[c],&m->sum_c[c],x);
+			neumaier(&m->sq[c],&m->sq_c[c],x*x);
+		}
+	}
+	for(c=0; c<width; c++)
+		if(!isfinite(m->sum[c]+m->sq[c]))
+			column_sums(m,c);
+}
+
+/* local mean and (population) variance of the next output row, mean[0] and
+ * var[0] being column c0 */
+void moments_row(moments *m, double *mean, double *var){
+	int c, curCol, cols, length, ncols;
+	double *row_add, *row_sub, x, y;
+	double s1, s1_c, s2, s2_c, m1, m2;
+	int *cm;
+	
+	cols=m->cols;
+	length=m->rows*cols;
+	ncols=m->width-cols+1;
+	cm=m->colmap;
+	
+	/* slide the column sums down to the window rows of this row */
+	if(m->slide){
+		row_sub=m->in->rows[m->row-m->scale-1];
+		row_add=m->in->rows[m->row+m->reach];
+		for(c=0; c<m->width; c++){
+			x=row_sub[cm[c]]-m->shift;
+			y=row_add[cm[c]]-m->shift;
+			neumaier(&m->sum[c],&m->sum_c[c],y);
+			neumaier(&m->sum[c],&m->sum_c[c],-x);
+			neumaier(&m->sq[c],&m->sq_c[c],y*y);
+			neumaier(&m->sq[c],&m->sq_c[c],-x*x);
+			if(!isfinite(m->sum[c]+m->sq[c]))
+				column_sums(m,c);
+		}
+	}
+	
+	/* slide the window totals along the row */
+	s1=s1_c=s2=s2_c=0;
+	for(c=0; c<cols; c++){
+		neumaier(&s1,&s1_c,m->sum[c]+m->sum_c[c]);
+		neumaier(&s2,&s2_c,m->sq[c]+m->sq_c[c]);
+	}
+	for(curCol=0; curCol<ncols; curCol++){
+		if(curCol>0){
+			c=curCol+cols-1;
+			neumaier(&s1,&s1_c,m->sum[c]+m->sum_c[c]);
+			neumaier(&s2,&s2_c,m->sq[c]+m->sq_c[c]);
+			c=curCol-1;
+			neumaier(&s1,&s1_c,-(m->sum[c]+m->sum_c[c]));
+			neumaier(&s2,&s2_c,-(m->sq[c]+m->sq_c[c]));
+		}
+		if(!isfinite(s1+s2)){
+			s1=s1_c=s2=s2_c=0;
+			for(c=curCol; c<curCol+cols; c++){
+				neumaier(&s1,&s1_c,m->sum[c]+m->sum_c[c]);
+				neumaier(&s2,&s2_c,m->sq[c]+m->sq_c[c]);
+			}
+			if(!isfinite(s1+s2)){
+				window_moments(m,curCol,&mean[curCol],
+								&var[curCol]);
+				continue;
+			}
+		}
+		m1=(s1+s1_c)/length;
+		m2=(s2+s2_c)/length-m1*m1;
+		mean[curCol]=m->shift+m1;
+		var[curCol]=m2>0 ? m2 : 0;
+	}
+	
+	m->row++;
+	m->slide=1;
+}
+
+/* add up the sums of window column c again from its values */
+static void column_sums(moments *m, int c){
+	int r;
+	double x;
+	
+	m->sum[c]=m->sum_c[c]=m->sq[c]=m->sq_c[c]=0;
+	for(r=m->row-m->scale; r<=m->row+m->reach; r++){
+		x=m->in->rows[r][m->colmap[c]]-m->shift;
+		neumaier(&m->sum[c],&m->sum_c[c],x);
+		neumaier(&m->sq[c],&m->sq_c[c],x*x);
+	}
+}
+
+/* mean and variance of the window of output column col (from c0) of the
+ * current row, from its values in the order lee2.c's lee() takes them */
+static void window_moments(moments *m, int col, double *mean, double *var){
+	int r, c;
+	double total=0, x;
+	
+	for(c=col; c<col+m->cols; c++)
+		for(r=m->row-m->scale; r<=m->row+m->reach; r++)
+			total+=m->in->rows[r][m->colmap[c]];
+	*mean=total/(m->rows*m->cols);
+	total=0;
+	for(c=col; c<col+m->cols; c++)
+		for(r=m->row-m->scale; r<=m->row+m->reach; r++){
+			x=m->in->rows[r][m->colmap[c]]-*mean;
+			total+=x*x;
+		}
+	*var=total/(m->rows*m->cols);
+}
+
+/* compensated (Neumaier) accumulation of x into *s, error kept in *c */
+static void neumaier(double *s, double *c, double x){
+	double t=*s+x;
+	if(fabs(*s)>=fabs(x))
+		*c+=(*s-t)+x;
+	else
+		*c+=(x-t)+*s;
+	*s=t;
+}
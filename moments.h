@@ -0,0 +1,30 @@
+/* moments.h */
+
+/* local mean and variance of every window of rows x cols (padded as
+ * border.h), produced one output row (of a tile) at a time at a cost per
+ * pixel independent of the window size. Safe to use from worker threads */
+
+#ifndef MOMENTS_H
+#define MOMENTS_H
+
+#include "arena.h"
+#include "border.h"
+
+typedef struct {
+	border *in;
+	int rows, cols;		/* window height and width */
+	int scale, reach;	/* window rows before and after the centre */
+	int row;		/* next output row */
+	int c0, width;		/* first output column, number of window columns */
+	int slide;		/* column sums still describe row-1 */
+	double shift;		/* subtracted from every value before summing */
+	double *sum, *sum_c;	/* column sums and their compensations */
+	double *sq, *sq_c;	/* column sums of squares and compensations */
+	int *colmap;		/* input column of each window column */
+} moments;
+
+size_t moments_scratch(int, int);
+void moments_init(moments*, arena*, border*, int, int, int, int, int);
+void moments_row(moments*, double*, double*);
+
+#endif
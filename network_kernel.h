@@ -0,0 +1,113 @@
+/* network_kernel.h */
+
+/* the 'network' median of med2.c for NW x NW windows, included by med2.c
+ * once per window side with these defined:
+ *
+ *	NW		window side (odd)
+ *	NFN(name)	name with the side appended
+ *	NET_PAIRS	a sorting network of NW values, as {a,b} pairs
+ *
+ * Every compare-exchange is a min and a max, with no branch on the data,
+ * applied to NET_BLOCK neighbouring output pixels at once (a last block
+ * of fewer sorting what its other lanes hold too). Each window column is sorted once per
+ * output row and shared by the NW windows holding it; the windows then sort
+ * their rows, which leaves the median among the taps near the
+ * anti-diagonal (see NFN(candidates)), and select it from those by
+ * discarding the smallest and largest until three remain */
+
+static const int NFN(pairs)[][2]=NET_PAIRS;
+
+/* taps (k*NW+j, row k and column j of the window with sorted rows and
+ * columns) that can be the median, returning how many. (k+1)*(j+1)-1 taps
+ * are no larger than tap k*NW+j and (NW-k)*(NW-j)-1 no smaller, so the
+ * others are ranked past the median on one side. As many are left out on
+ * either side, so the median is the middle candidate too */
+static int NFN(candidates)(int *cand){
+	int k, j, n, rank;
+
+	rank=(NW*NW-1)/2;
+	n=0;
+	for(k=0; k<NW; k++){
+		for(j=0; j<NW; j++){
+			if((k+1)*(j+1)-1<=rank && (NW-k)*(NW-j)-1<=rank)
+				cand[n++]=k*NW+j;
+		}
+	}
+	return n;
+}
+
+/* perform filtering of output rows r0..r1-1, columns c0..c1-1 */
+static void NFN(filter_network)(border *m_in, double **m_out, int r0, int r1,
+					int c0, int c1, arena *scratch){
+	int curRow, curCol, k, j, p, i, n, nb, width, scale;
+	int cand[NW*NW], set[NW*NW], ncand, next;
+	double *col;			/* window columns, sorted: col[k*width+x]
+					 * is rank k of column c0-scale+x */
+	double *t;			/* the taps of NET_BLOCK windows,
+					 * t[tap*NET_BLOCK+pixel] */
+	double *row, *out;
+	int *cols;
+
+	scale=(NW-1)/2;		/* taps either side of the centre */
+	width=c1-c0+NW-1;
+	cols=m_in->cols+c0-scale;
+	col = (double*) arena_alloc (scratch,(size_t)NW*width*sizeof(double));
+	t = (double*) arena_alloc (scratch,NW*NW*NET_BLOCK*sizeof(double));
+	memset(t,0,NW*NW*NET_BLOCK*sizeof(double));	/* lanes past the
+							 * last pixel */
+	ncand=NFN(candidates)(cand);
+
+	for(curRow=r0; curRow<r1; curRow++){
+		/* every window column, sorted */
+		for(k=0; k<NW; k++){
+			row=m_in->rows[curRow-scale+k];
+			for(i=0; i<width; i++)
+				col[k*width+i]=row[cols[i]];
+		}
+		for(p=0; p<(int)(sizeof(NFN(pairs))/sizeof(NFN(pairs)[0])); p++)
+			NET_SORT(col+NFN(pairs)[p][0]*width,
+					col+NFN(pairs)[p][1]*width,width);
+
+		for(curCol=c0; curCol<c1; curCol+=nb){
+			nb=c1-curCol<NET_BLOCK ? c1-curCol : NET_BLOCK;
+
+			/* the windows, their rows sorted */
+			for(k=0; k<NW; k++){
+				for(j=0; j<NW; j++){
+					row=col+k*width+curCol-c0+j;
+					for(i=0; i<nb; i++)
+						t[(k*NW+j)*NET_BLOCK+i]=row[i];
+				}
+				for(p=0; p<(int)(sizeof(NFN(pairs))/sizeof(NFN(pairs)[0])); p++)
+					NET_SORT(t+(k*NW+NFN(pairs)[p][0])*NET_BLOCK,
+					t+(k*NW+NFN(pairs)[p][1])*NET_BLOCK,NET_BLOCK);
+			}
+
+			/* forgetful selection among the candidates: holding
+			 * one more than half of them, the smallest and largest
+			 * held cannot be the median, so both go and the next
+			 * candidate comes in, until three are left */
+			n=(ncand+1)/2+1;
+			for(i=0; i<n; i++)
+				set[i]=cand[i];
+			for(next=n; next<ncand; next++){
+				for(i=1; i<n; i++)
+					NET_SORT(t+set[0]*NET_BLOCK,
+						t+set[i]*NET_BLOCK,NET_BLOCK);
+				for(i=1; i<n-1; i++)
+					NET_SORT(t+set[i]*NET_BLOCK,
+						t+set[n-1]*NET_BLOCK,NET_BLOCK);
+				set[0]=cand[next];
+				n--;
+			}
+
+			/* the middle one of the three left */
+			NET_SORT(t+set[0]*NET_BLOCK,t+set[1]*NET_BLOCK,NET_BLOCK);
+			NET_SORT(t+set[1]*NET_BLOCK,t+set[2]*NET_BLOCK,NET_BLOCK);
+			NET_SORT(t+set[0]*NET_BLOCK,t+set[1]*NET_BLOCK,NET_BLOCK);
+			out=m_out[curRow]+curCol;
+			for(i=0; i<nb; i++)
+				out[i]=t[set[1]*NET_BLOCK+i];
+		}
+	}
+}
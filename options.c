@@ -0,0 +1,532 @@
+/* options.c */
+
+#include <limits.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mex.h"
+#include "options.h"
+#include "stats.h"
+
+/* MATLAB class of each FILTER_ class */
+static const mxClassID mx_classes[]={
+	mxUNKNOWN_CLASS, mxDOUBLE_CLASS, mxSINGLE_CLASS,
+	mxUINT8_CLASS, mxUINT16_CLASS, mxINT16_CLASS
+};
+
+/* what 'persistent' calls keep, the mex file staying locked while it is
+ * not null (see release_call()) */
+static filter_cache *kept;
+
+/* the earlier call of 'previous', 'kept' and 'changed' */
+static filter_previous previous;
+
+/* a call made with 'async': the job and the copies of the arrays it reads
+ * and writes, MATLAB's own being free to change once the call returns */
+#define MAX_JOBS	64
+typedef struct {
+	double id;			/* handle, 0 for a free slot */
+	filter_job *job;
+	void *in, *out;
+	unsigned char *mask;
+	int out_class;
+	mwSize ndims, dims[8];
+	int passes;
+	filter_stats stats;
+	int timed;
+} mex_job;
+
+static int async;			/* 'async' true in the call parsed */
+static mex_job jobs[MAX_JOBS];
+static int njobs;			/* jobs not yet fetched, which keep
+					 * the mex file locked */
+static double last_id;
+
+/* the one mexLock() held while kept or njobs is set (MATLAB counts them) */
+static int locked;
+
+/* prototypes */
+static filter_cache *keep_cache(void);
+static void update_lock(void);
+static void free_kept(void);
+static void get_previous(filter_options*, int, const mxArray*,
+				const mxArray*, const mxArray*, const mxArray*);
+static void read_data(filter_data*, const mxArray*, int);
+static mex_job *find_job(const mxArray*);
+static void drop_job(mex_job*);
+static void end_jobs(void);
+static void unload(void);
+static int whole(double, double);
+
+/* parse the name/value pairs prhs[first] .. prhs[nrhs-1], the 'class' one
+ * into out_class (FILTER_SAME when not given). prhs[0] is the input, which
+ * a 'mask' and an earlier call must match */
+void get_options(filter_options *opts, int *out_class, int first, int nrhs,
+						const mxArray *prhs[]){
+	char name[32];
+	int i;
+	const mxArray *earlier_in=0, *earlier_out=0, *changed=0;
+	
+	filter_defaults(opts);
+	*out_class=FILTER_SAME;
+	async=0;
+	
+	if((nrhs-first)%2 !=0)
+		mexErrMsgTxt("options must be name/value pairs");
+	for(i=first; i<nrhs; i+=2){
+		if(!mxIsChar(prhs[i]))
+			mexErrMsgTxt("option names must be strings");
+		mxGetString(prhs[i],name,sizeof(name));
+		if(!strcmp(name,"method")){
+			if(!mxIsChar(prhs[i+1]))
+				mexErrMsgTxt("'method' must be a string");
+			mxGetString(prhs[i+1],opts->method,sizeof(opts->method));
+		}
+		else if(!strcmp(name,"threads")){
+			opts->threads=get_int(prhs[i+1],0,
+				"'threads' must be a non-negative whole number");
+		}
+		else if(!strcmp(name,"border")){
+			/* a policy name, or a number to pad with */
+			if(mxIsChar(prhs[i+1])){
+				mxGetString(prhs[i+1],name,sizeof(name));
+				opts->border=filter_border_named(name);
+				if(opts->border<0)
+					mexErrMsgTxt(filter_message(FILTER_ERR_BORDER));
+			}
+			else{
+				opts->border=BORDER_CONSTANT;
+				opts->border_value=mxGetScalar(prhs[i+1]);
+			}
+		}
+		else if(!strcmp(name,"class")){
+			if(!mxIsChar(prhs[i+1]))
+				mexErrMsgTxt("'class' must be a string");
+			mxGetString(prhs[i+1],name,sizeof(name));
+			*out_class=filter_class_named(name);
+			if(*out_class<0)
+				mexErrMsgTxt("class must be 'same', 'double', 'single', 'uint8', 'uint16' or 'int16'");
+		}
+		else if(!strcmp(name,"iterations")){
+			opts->iterations=get_int(prhs[i+1],1,
+				"'iterations' must be a positive whole number");
+		}
+		else if(!strcmp(name,"tolerance")){
+			if(mxIsChar(prhs[i+1]) || !(mxGetScalar(prhs[i+1])>=0))
+				mexErrMsgTxt("'tolerance' must be a non-negative number");
+			opts->tolerance=mxGetScalar(prhs[i+1]);
+		}
+		else if(!strcmp(name,"sigma")){
+			/* one for both axes, or [rows cols] as windows are */
+			if(mxGetClassID(prhs[i+1])!=mxDOUBLE_CLASS
+			    || mxGetNumberOfElements(prhs[i+1])<1
+			    || mxGetNumberOfElements(prhs[i+1])>2)
+				mexErrMsgTxt("'sigma' must be a number or [rows cols]");
+			opts->sigma[0]=mxGetPr(prhs[i+1])[0];
+			opts->sigma[1]=mxGetPr(prhs[i+1])
+					[mxGetNumberOfElements(prhs[i+1])-1];
+			if(!(opts->sigma[0]>=0) || !(opts->sigma[1]>=0))
+				mexErrMsgTxt("'sigma' must not be negative");
+		}
+		else if(!strcmp(name,"mask")){
+			/* a frame of the input, logical (or uint8) being one
+			 * byte per element already */
+			if(!(mxIsLogical(prhs[i+1])
+				|| mxGetClassID(prhs[i+1])==mxUINT8_CLASS)
+			    || mxGetM(prhs[i+1])!=mxGetM(prhs[0])
+			    || mxGetNumberOfElements(prhs[i+1])
+					!=mxGetM(prhs[0])*mxGetDimensions(prhs[0])[1])
+				mexErrMsgTxt("'mask' must be logical and as large as a matrix of the input");
+			opts->mask=(const unsigned char*)mxGetData(prhs[i+1]);
+		}
+		else if(!strcmp(name,"previous"))
+			earlier_in=prhs[i+1];
+		else if(!strcmp(name,"kept"))
+			earlier_out=prhs[i+1];
+		else if(!strcmp(name,"changed"))
+			changed=prhs[i+1];
+		else if(!strcmp(name,"async")){
+			if(mxIsChar(prhs[i+1]))
+				mexErrMsgTxt("'async' must be true or false");
+			async=mxGetScalar(prhs[i+1])!=0;
+		}
+		else if(!strcmp(name,"persistent")){
+			if(mxIsChar(prhs[i+1]))
+				mexErrMsgTxt("'persistent' must be true or false");
+			if(mxGetScalar(prhs[i+1])!=0)
+				opts->cache=keep_cache();
+		}
+		else
+			mexErrMsgTxt("unknown option (expected 'method', 'threads', 'border', 'class', 'mask', 'previous', 'kept', 'changed', 'iterations', 'tolerance', 'sigma', 'persistent' or 'async')");
+	}
+	if(earlier_in || earlier_out || changed)
+		get_previous(opts,*out_class,prhs[0],earlier_in,earlier_out,
+								changed);
+}
+
+/* the earlier call of the options into opts: its input in (unless null),
+ * output out and the changed rectangles since (unless null, else found by
+ * comparing in with the input prhs0), for outputs of out_class */
+static void get_previous(filter_options *opts, int out_class,
+			const mxArray *prhs0, const mxArray *in,
+			const mxArray *out, const mxArray *changed){
+	mxClassID cls;
+	double *rect;
+	int *c;
+	size_t k, n;
+
+	cls=out_class==FILTER_SAME ? mxGetClassID(prhs0) : mx_classes[out_class];
+	if(!out || mxGetClassID(out)!=cls || mxIsComplex(out)
+	    || mxGetNumberOfElements(out)!=mxGetNumberOfElements(prhs0))
+		mexErrMsgTxt("'kept' must be the output of the earlier call ('previous' or 'changed' saying what changed since)");
+	if(in && (mxGetClassID(in)!=mxGetClassID(prhs0) || mxIsComplex(in)
+	    || mxGetNumberOfElements(in)!=mxGetNumberOfElements(prhs0)))
+		mexErrMsgTxt("'previous' must be the input of the earlier call");
+	if(!in && !changed)
+		mexErrMsgTxt("'kept' needs 'previous' or 'changed'");
+	previous.in=in ? mxGetData(in) : 0;
+	previous.out=mxGetData(out);
+	previous.changed=0;
+	previous.nchanged=0;
+	if(changed){
+		/* rows [row0 row1 col0 col1], from 1 and inclusive */
+		n=mxGetNumberOfElements(changed);
+		if(mxGetClassID(changed)!=mxDOUBLE_CLASS
+		    || (n && mxGetN(changed)!=4))
+			mexErrMsgTxt("'changed' must be rows of [row0 row1 col0 col1]");
+		n/=4;
+		rect=mxGetPr(changed);
+		for(k=0; k<4*n; k++)
+			if(!whole(rect[k],0))
+				mexErrMsgTxt("'changed' must hold whole row and column numbers");
+		c = (int*) mxMalloc (4*n*sizeof(int)+1);
+		for(k=0; k<n; k++){
+			c[4*k]=(int)rect[k]-1;
+			c[4*k+1]=(int)rect[n+k];
+			c[4*k+2]=(int)rect[2*n+k]-1;
+			c[4*k+3]=(int)rect[3*n+k];
+		}
+		previous.changed=c;
+		previous.nchanged=(int)n;
+	}
+	opts->previous=&previous;
+}
+
+/* the window size argument: a side, returned, or [rows cols], which goes
+ * into opts->window (so after get_options()) */
+int get_window(filter_options *opts, const mxArray *arg){
+	double *size;
+
+	if(mxIsChar(arg) || mxGetNumberOfElements(arg)<1
+	    || mxGetNumberOfElements(arg)>2)
+		mexErrMsgTxt("window size must be a number or [rows cols]");
+	if(mxGetNumberOfElements(arg)==1)
+		return get_int(arg,1,filter_message(FILTER_ERR_WINDOW));
+	if(mxGetClassID(arg)!=mxDOUBLE_CLASS)
+		mexErrMsgTxt("[rows cols] of the window must be double");
+	size=mxGetPr(arg);
+	if(!whole(size[0],1) || !whole(size[1],1))
+		check_status(FILTER_ERR_WINDOW);
+	opts->window[0]=(int)size[0];
+	opts->window[1]=(int)size[1];
+	return opts->window[0];
+}
+
+/* the number arg holds, failing with message unless it is whole and from lo
+ * to INT_MAX (casting others, NaN above all, being undefined) */
+int get_int(const mxArray *arg, double lo, const char *message){
+	if(mxIsChar(arg) || !whole(mxGetScalar(arg),lo))
+		mexErrMsgTxt(message);
+	return (int)mxGetScalar(arg);
+}
+
+/* 1 when x is a whole number from lo to INT_MAX, else 0 (for NaN too) */
+static int whole(double x, double lo){
+	return x>=lo && x<=INT_MAX && x==floor(x);
+}
+
+/* in as filters.h takes it, with a new output of its shape and of class
+ * out_class (FILTER_SAME for that of in) returned in out */
+void get_data(filter_data *d, mxArray **out, const mxArray *in, int out_class){
+	read_data(d,in,out_class);
+	*out=mxCreateNumericArray(mxGetNumberOfDimensions(in),
+		mxGetDimensions(in),mx_classes[d->out_class],mxREAL);
+	d->out=mxGetData(*out);
+}
+
+/* in as filters.h takes it, but for d->out */
+static void read_data(filter_data *d, const mxArray *in, int out_class){
+	const mwSize *dims;
+	mwSize ndims, i;
+	size_t no_frames;
+	
+	/* preventing sparse, complex and string matrices, and classes with no
+	 * loader in typed.c */
+	d->in_class=-1;
+	for(i=FILTER_DOUBLE; i<=FILTER_INT16; i++)
+		if(mxGetClassID(in)==mx_classes[i])
+			d->in_class=(int)i;
+	if( mxIsComplex(in) || mxIsClass(in,"sparse") || d->in_class<0 )
+		mexErrMsgTxt("input must be real, full and double, single, uint8, uint16 or int16");
+	d->out_class=out_class==FILTER_SAME ? d->in_class : out_class;
+	
+	/* a stack being its frames (every dimension past 2) one after the
+	 * other */
+	ndims=mxGetNumberOfDimensions(in);
+	dims=mxGetDimensions(in);
+	no_frames=1;
+	for(i=2; i<ndims; i++)
+		no_frames*=dims[i];
+	d->no_rows=(int)dims[0];
+	d->no_cols=(int)dims[1];
+	d->no_frames=(int)no_frames;
+	d->in=mxGetData(in);
+	d->out=0;
+}
+
+/* with 'async' given, start run, the filter called name (see
+ * filter_submit()), on copies of in (and a 'mask'), its output of class
+ * out_class, timing it when stats is not null, and return 1 with its handle
+ * in *out; else 0 */
+int submit_job(filter_fn run, const char *name, mxArray **out,
+		const mxArray *in,
+		int out_class, int ws, int nlook, int damp,
+		filter_options *opts, const filter_stats *stats){
+	filter_data d;
+	mex_job *j=0;
+	size_t n, bytes;
+	mwSize i;
+	int k, rc;
+
+	if(!async)
+		return 0;
+	if(opts->cache)
+		mexErrMsgTxt("'persistent' calls cannot be 'async'");
+	if(opts->previous)
+		mexErrMsgTxt("'previous', 'kept' and 'changed' cannot be 'async'");
+	if(mxGetNumberOfDimensions(in)>8)
+		mexErrMsgTxt("'async' inputs have at most 8 dimensions");
+	for(k=0; k<MAX_JOBS && !j; k++)
+		if(!jobs[k].id)
+			j=&jobs[k];
+	if(!j)
+		mexErrMsgTxt("too many 'async' jobs not yet fetched with 'wait' or 'cancel'");
+
+	read_data(&d,in,out_class);
+	n=mxGetNumberOfElements(in);
+	bytes=n*filter_class_size(d.in_class);
+	j->in=malloc(bytes+1);
+	j->out=malloc(n*filter_class_size(d.out_class)+1);
+	j->mask=0;
+	if(opts->mask)
+		j->mask = (unsigned char*) malloc ((size_t)d.no_rows*d.no_cols+1);
+	if(!j->in || !j->out || (opts->mask && !j->mask)){
+		drop_job(j);
+		check_status(FILTER_ERR_MEMORY);
+	}
+	memcpy(j->in,d.in,bytes);
+	d.in=j->in;
+	d.out=j->out;
+	if(opts->mask){
+		memcpy(j->mask,opts->mask,(size_t)d.no_rows*d.no_cols);
+		opts->mask=j->mask;
+	}
+	j->out_class=d.out_class;
+	j->ndims=mxGetNumberOfDimensions(in);
+	for(i=0; i<j->ndims; i++)
+		j->dims[i]=mxGetDimensions(in)[i];
+	j->passes=0;
+	opts->passes=&j->passes;
+	j->timed=stats!=0;
+	memset(&j->stats,0,sizeof(filter_stats));
+	opts->stats=j->timed ? &j->stats : 0;
+
+	rc=filter_submit(&j->job,run,name,&d,ws,nlook,damp,opts);
+	if(rc!=FILTER_OK){
+		drop_job(j);
+		check_status(rc);
+	}
+	j->id=++last_id;
+	njobs++;
+	update_lock();			/* the job's thread runs this code */
+	*out=mxCreateDoubleScalar(j->id);
+	return 1;
+}
+
+/* raise an error when 'async' was given to a mex file with no jobs */
+void no_async(void){
+	if(async)
+		mexErrMsgTxt("'async' is for AV2_M, MED2_M, LEE2_M and ELEE2_M");
+}
+
+/* 1 when the call is a job's NAME('poll',h), NAME('wait',h) or
+ * NAME('cancel',h) (of the mex file called name), having answered it into
+ * plhs, else 0 */
+int job_call(const char *name, int nlhs, mxArray *plhs[], int nrhs,
+						const mxArray *prhs[]){
+	char call[16];
+	mex_job *j;
+	int rc;
+
+	if(nrhs!=2 || !mxIsChar(prhs[0]))
+		return 0;
+	mxGetString(prhs[0],call,sizeof(call));
+	if(strcmp(call,"poll") && strcmp(call,"wait") && strcmp(call,"cancel"))
+		return 0;
+	j=find_job(prhs[1]);
+	if(!strcmp(call,"poll")){
+		plhs[0]=mxCreateDoubleScalar(filter_poll(j->job));
+		return 1;
+	}
+	if(!strcmp(call,"cancel")){
+		filter_cancel(j->job);
+		filter_wait(j->job);
+		drop_job(j);
+		return 1;
+	}
+
+	/* 'wait': the output, as the call would have returned it */
+	rc=filter_wait(j->job);
+	if(rc!=FILTER_OK){
+		drop_job(j);
+		check_status(rc);
+	}
+	plhs[0]=mxCreateNumericArray(j->ndims,j->dims,mx_classes[j->out_class],
+								mxREAL);
+	memcpy(mxGetData(plhs[0]),j->out,mxGetNumberOfElements(plhs[0])
+					*filter_class_size(j->out_class));
+	if(nlhs==2)
+		plhs[1]=mxCreateDoubleScalar(j->passes);
+	if(j->timed)
+		put_stats(name,&j->stats);
+	drop_job(j);
+	return 1;
+}
+
+/* stats, cleared and timed from now, when the FILTER_STATS environment
+ * variable is set (and not "0"), else null */
+filter_stats *get_stats(filter_stats *stats, double *since){
+	const char *env;
+	
+	env=getenv("FILTER_STATS");
+	if(!env || !env[0] || !strcmp(env,"0"))
+		return 0;
+	memset(stats,0,sizeof(filter_stats));
+	stats_start(stats,since);
+	return stats;
+}
+
+/* the arguments are read and the outputs made, since *since */
+void args_read(filter_stats *stats, double *since){
+	stats_phase(stats,FILTER_PHASE_ARGS,since);
+}
+
+/* print stats of the mex file called name as one line, unless null */
+void put_stats(const char *name, const filter_stats *stats){
+	char text[512];
+	
+	if(!stats)
+		return;
+	filter_stats_text(stats,text,sizeof(text));
+	mexPrintf("%s: %s\n",name,text);
+}
+
+/* 1 when the call is NAME('release'), having freed what 'persistent'
+ * calls kept and unlocked the mex file, else 0 */
+int release_call(int nrhs, const mxArray *prhs[]){
+	char name[16];
+	
+	if(nrhs!=1 || !mxIsChar(prhs[0]))
+		return 0;
+	mxGetString(prhs[0],name,sizeof(name));
+	if(strcmp(name,"release"))
+		return 0;
+	free_kept();
+	update_lock();			/* still held while jobs run */
+	return 1;
+}
+
+/* the end of a call: the mex file is unlocked (which allows for
+ * re-compiling) unless it keeps a cache or has jobs running */
+void end_call(void){
+	update_lock();
+}
+
+/* lock the mex file once when a cache is kept or jobs run, and unlock it
+ * once when neither is left */
+static void update_lock(void){
+	if((kept || njobs) && !locked){
+		mexLock();
+		mexAtExit(unload);
+		locked=1;
+	}
+	else if(!kept && !njobs && locked){
+		mexUnlock();
+		locked=0;
+	}
+}
+
+/* the job of handle h, raising an error for none */
+static mex_job *find_job(const mxArray *h){
+	int k;
+
+	if(!mxIsChar(h) && mxGetNumberOfElements(h)==1)
+		for(k=0; k<MAX_JOBS; k++)
+			if(jobs[k].id && jobs[k].id==mxGetScalar(h))
+				return &jobs[k];
+	mexErrMsgTxt("no such 'async' job (fetched or cancelled already?)");
+	return 0;
+}
+
+/* free job j (finished, or never started) and its slot */
+static void drop_job(mex_job *j){
+	filter_job_free(j->job);
+	free(j->in);
+	free(j->out);
+	free(j->mask);
+	if(j->id)
+		njobs--;
+	memset(j,0,sizeof(mex_job));
+	update_lock();
+}
+
+/* cancel and free every job */
+static void end_jobs(void){
+	int k;
+
+	for(k=0; k<MAX_JOBS; k++)
+		if(jobs[k].id){
+			filter_cancel(jobs[k].job);
+			drop_job(&jobs[k]);
+		}
+}
+
+/* the cache of 'persistent' calls, made by the first of them, which locks
+ * the mex file so that clearing it cannot lose the cache */
+static filter_cache *keep_cache(void){
+	if(!kept){
+		kept=filter_cache_create();
+		if(!kept)
+			check_status(FILTER_ERR_MEMORY);
+		update_lock();
+	}
+	return kept;
+}
+
+/* stop the cache's threads and free it */
+static void free_kept(void){
+	filter_cache_free(kept);
+	kept=0;
+}
+
+/* the mex file being cleared, or MATLAB's exit (mexAtExit()) */
+static void unload(void){
+	end_jobs();
+	free_kept();
+}
+
+/* raise the MATLAB error of a FILTER_ return code */
+void check_status(int code){
+	if(code!=FILTER_OK)
+		mexErrMsgTxt(filter_message(code));
+}
@@ -0,0 +1,27 @@
+/* options.h */
+
+/* what the mex files share: the optional name/value pairs and the passing
+ * of MATLAB arrays to and results from filters.h */
+
+#ifndef OPTIONS_H
+#define OPTIONS_H
+
+#include "mex.h"
+#include "filters.h"
+
+void get_options(filter_options*, int*, int, int, const mxArray*[]);
+int get_window(filter_options*, const mxArray*);
+int get_int(const mxArray*, double, const char*);
+void get_data(filter_data*, mxArray**, const mxArray*, int);
+int submit_job(filter_fn, const char*, mxArray**, const mxArray*, int, int,
+				int, int, filter_options*, const filter_stats*);
+void no_async(void);
+int job_call(const char*, int, mxArray*[], int, const mxArray*[]);
+void check_status(int);
+int release_call(int, const mxArray*[]);
+void end_call(void);
+filter_stats *get_stats(filter_stats*, double*);
+void args_read(filter_stats*, double*);
+void put_stats(const char*, const filter_stats*);
+
+#endif
@@ -0,0 +1,349 @@
+/* parallel.c */
+
+/* Tiles are numbered row by row, frame after frame, and dealt out to the workers as contiguous
+ * ranges, so neighbouring tiles (which share input rows) tend to run on the
+ * same worker. A worker that runs out of tiles steals the back half of the
+ * range of the worker with the most tiles left, which keeps the load even
+ * when tiles differ in cost (median windows on busy image regions).
+ *
+ * Workers are threads started for the one run, or the threads of a
+ * worker_pool that sleep between runs, so that calls made one after another
+ * (a cache's, see cache.h) start none.
+ *
+ * Jobs run on plain threads: they must not call the MATLAB API (mxMalloc,
+ * mexErrMsgTxt, ...), which is only safe on the MATLAB thread. */
+
+#include <stdlib.h>
+#include "parallel.h"
+#include "stats.h"
+#include "threads.h"
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+/* tiles next .. end-1 still to be run by one worker */
+typedef struct {
+	int next, end;
+	lock_t lock;
+} tile_queue;
+
+typedef struct {
+	tile_plan *plan;
+	tile_job job;
+	void *arg;
+	tile_queue *queues;
+} tile_pool;
+
+typedef struct {
+	tile_pool *pool;
+	int worker;
+	worker_pool *owner;		/* a pool's thread, else null */
+	int round;			/* of the owner's last run seen */
+} worker_args;
+
+/* threads 1..nthreads, asleep on wake between runs. Each run bumps round;
+ * workers below active take part, running counting those not done yet */
+struct worker_pool {
+	lock_t lock;
+	cond_t wake, done;
+	thread_t threads[MAX_THREADS];
+	worker_args args[MAX_THREADS];
+	int nthreads;
+	tile_pool *run;			/* the run in progress */
+	int round, active, running;
+	int quit;
+};
+
+/* prototypes */
+static int take_tile(tile_pool*, int);
+static void work(tile_pool*, int);
+static void pool_grow(worker_pool*, int);
+static void pool_serve(worker_args*);
+static THREAD_RESULT worker_main(thread_arg);
+
+/* number of workers to use: the per call request if given, else the
+ * FILTER_THREADS environment variable, else one per processor */
+int parallel_threads(int requested){
+	char *env;
+	int n=requested;
+	
+	if(n<=0){
+		env=getenv("FILTER_THREADS");
+		if(env)
+			n=atoi(env);
+	}
+	if(n<=0){
+#ifdef _WIN32
+		SYSTEM_INFO info;
+		GetSystemInfo(&info);
+		n=(int)info.dwNumberOfProcessors;
+#else
+		n=(int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+	}
+	if(n<1)
+		n=1;
+	if(n>MAX_THREADS)
+		n=MAX_THREADS;
+	return n;
+}
+
+/* cut rows r0..r1-1, columns c0..c1-1 of no_frames outputs into tiles for
+ * nthreads workers and windows of win_rows x win_cols, the tiles being large
+ * enough for the per tile set up of the sliding engines (about one window
+ * of rows and columns) to stay small next to the tile. Small frames make
+ * one tile each, so a stack of them still spreads over the workers. Tiles
+ * start at r0 and c0, so a part starting on a multiple of the tile size is
+ * cut as the whole image is */
+void plan_tiles(tile_plan *plan, int no_frames, int r0, int r1, int c0,
+			int c1, int win_rows, int win_cols, int nthreads){
+	int no_rows=r1-r0, no_cols=c1-c0;
+
+	plan->no_frames=no_frames;
+	plan->no_rows=no_rows;
+	plan->no_cols=no_cols;
+	plan->r0=r0;
+	plan->c0=c0;
+	plan->tile_rows=TILE_HEIGHT(win_rows);
+	plan->tile_cols=TILE_WIDTH(win_cols);
+	if(plan->tile_rows>no_rows)
+		plan->tile_rows=no_rows>0 ? no_rows : 1;
+	if(plan->tile_cols>no_cols)
+		plan->tile_cols=no_cols>0 ? no_cols : 1;
+	plan->tiles_across=(no_cols+plan->tile_cols-1)/plan->tile_cols;
+	plan->tiles_per_frame=plan->tiles_across
+			*((no_rows+plan->tile_rows-1)/plan->tile_rows);
+	plan->ntiles=no_frames*plan->tiles_per_frame;
+	
+	plan->cancel=0;
+	plan->nworkers=nthreads<plan->ntiles ? nthreads : plan->ntiles;
+	if(plan->nworkers<1)
+		plan->nworkers=1;
+	if(plan->nworkers>MAX_THREADS)
+		plan->nworkers=MAX_THREADS;
+}
+
+/* run job over every tile of plan, the calling thread being worker 0 and the
+ * others the threads of workers (started as needed), or threads of this run
+ * when null. Times it and each worker into plan (for filter_stats, a few
+ * clock reads a call) */
+void run_tiles(tile_plan *plan, tile_job job, void *arg, worker_pool *workers){
+	tile_pool pool;
+	int w, n, share, extra;
+	double start;
+	thread_t threads[MAX_THREADS];
+	int started[MAX_THREADS];
+	worker_args args[MAX_THREADS];
+	tile_queue queues[MAX_THREADS];
+	
+	plan->elapsed=0;
+	for(w=0; w<plan->nworkers; w++)
+		plan->busy[w]=0;
+	if(plan->ntiles<=0)
+		return;
+	start=stats_clock();
+	pool.plan=plan;
+	pool.job=job;
+	pool.arg=arg;
+	n=plan->nworkers;
+	pool.queues=queues;
+	
+	/* deal the tiles out in contiguous ranges */
+	share=plan->ntiles/n;
+	extra=plan->ntiles%n;
+	for(w=0; w<n; w++){
+		pool.queues[w].next=w*share+(w<extra ? w : extra);
+		pool.queues[w].end=pool.queues[w].next+share+(w<extra);
+		LOCK_INIT(&pool.queues[w].lock);
+	}
+	
+	/* a worker whose thread does not start has its tiles stolen by the
+	 * others */
+	if(workers){
+		pool_grow(workers,n-1);
+		LOCK(&workers->lock);
+		workers->run=&pool;
+		workers->active=n;
+		workers->running=n-1<workers->nthreads ? n-1 : workers->nthreads;
+		workers->round++;
+		WAKE_ALL(&workers->wake);
+		UNLOCK(&workers->lock);
+	}
+	else{
+		for(w=1; w<n; w++){
+			args[w].pool=&pool;
+			args[w].worker=w;
+			args[w].owner=0;
+			started[w]=THREAD_START(&threads[w],worker_main,&args[w]);
+		}
+	}
+	work(&pool,0);
+	if(workers){
+		LOCK(&workers->lock);
+		while(workers->running>0)
+			WAIT(&workers->done,&workers->lock);
+		workers->run=0;
+		UNLOCK(&workers->lock);
+	}
+	else{
+		for(w=1; w<n; w++){
+			if(!started[w])
+				continue;
+			THREAD_JOIN(threads[w]);
+		}
+	}
+	
+	for(w=0; w<n; w++)
+		LOCK_FREE(&pool.queues[w].lock);
+	plan->elapsed=stats_clock()-start;
+}
+
+/* a pool with no threads yet, null when out of memory */
+worker_pool *pool_create(void){
+	worker_pool *p;
+	
+	p=(worker_pool*)calloc(1,sizeof(worker_pool));
+	if(!p)
+		return 0;
+	LOCK_INIT(&p->lock);
+	COND_INIT(&p->wake);
+	COND_INIT(&p->done);
+	return p;
+}
+
+/* stop and join the threads of p and free it */
+void pool_free(worker_pool *p){
+	int w;
+	
+	if(!p)
+		return;
+	LOCK(&p->lock);
+	p->quit=1;
+	WAKE_ALL(&p->wake);
+	UNLOCK(&p->lock);
+	for(w=1; w<=p->nthreads; w++){
+		THREAD_JOIN(p->threads[w]);
+	}
+	COND_FREE(&p->wake);
+	COND_FREE(&p->done);
+	LOCK_FREE(&p->lock);
+	free(p);
+}
+
+/* start threads up to worker n (between runs, so none reads round yet) */
+static void pool_grow(worker_pool *p, int n){
+	worker_args *a;
+	
+	while(p->nthreads<n && p->nthreads<MAX_THREADS-1){
+		a=&p->args[p->nthreads+1];
+		a->pool=0;
+		a->worker=p->nthreads+1;
+		a->owner=p;
+		a->round=p->round;
+		if(!THREAD_START(&p->threads[a->worker],worker_main,a))
+			break;
+		p->nthreads++;
+	}
+}
+
+/* a pool's thread: wait for each run and take part when among its active
+ * workers */
+static void pool_serve(worker_args *a){
+	worker_pool *p=a->owner;
+	tile_pool *run;
+	
+	LOCK(&p->lock);
+	for(;;){
+		while(p->round==a->round && !p->quit)
+			WAIT(&p->wake,&p->lock);
+		if(p->quit)
+			break;
+		a->round=p->round;
+		if(a->worker>=p->active)
+			continue;
+		run=p->run;
+		UNLOCK(&p->lock);
+		work(run,a->worker);
+		LOCK(&p->lock);
+		if(--p->running==0)
+			WAKE_ALL(&p->done);
+	}
+	UNLOCK(&p->lock);
+}
+
+/* run tiles until every queue is empty, or the run is cancelled */
+static void work(tile_pool *pool, int worker){
+	tile_plan *plan=pool->plan;
+	int t, frame, r0, c0, r1, c1;
+	double start;
+	
+	start=stats_clock();
+	while(!(plan->cancel && *plan->cancel)
+	    && (t=take_tile(pool,worker))>=0){
+		frame=t/plan->tiles_per_frame;
+		t%=plan->tiles_per_frame;
+		r0=(t/plan->tiles_across)*plan->tile_rows;
+		c0=(t%plan->tiles_across)*plan->tile_cols;
+		r1=r0+plan->tile_rows<plan->no_rows ? r0+plan->tile_rows : plan->no_rows;
+		c1=c0+plan->tile_cols<plan->no_cols ? c0+plan->tile_cols : plan->no_cols;
+		pool->job(pool->arg,frame,plan->r0+r0,plan->r0+r1,
+					plan->c0+c0,plan->c0+c1,worker);
+	}
+	plan->busy[worker]=stats_clock()-start;
+}
+
+/* next tile of this worker, stolen from the busiest worker when its own
+ * range is used up, -1 when no tiles are left anywhere */
+static int take_tile(tile_pool *pool, int worker){
+	tile_queue *own, *victim;
+	int v, left, most, busiest, first, last;
+	
+	own=&pool->queues[worker];
+	LOCK(&own->lock);
+	first=own->next<own->end ? own->next++ : -1;
+	UNLOCK(&own->lock);
+	if(first>=0)
+		return first;
+	
+	for(;;){
+		busiest=-1;
+		most=0;
+		for(v=0; v<pool->plan->nworkers; v++){
+			victim=&pool->queues[v];
+			LOCK(&victim->lock);
+			left=victim->end-victim->next;
+			UNLOCK(&victim->lock);
+			if(left>most){
+				most=left;
+				busiest=v;
+			}
+		}
+		if(busiest<0)
+			return -1;
+		
+		/* the back half, which the victim is furthest from */
+		victim=&pool->queues[busiest];
+		LOCK(&victim->lock);
+		left=victim->end-victim->next;
+		last=victim->end;
+		victim->end-=(left+1)/2;
+		first=victim->end;
+		UNLOCK(&victim->lock);
+		if(first<last){
+			LOCK(&own->lock);
+			own->next=first+1;
+			own->end=last;
+			UNLOCK(&own->lock);
+			return first;
+		}
+	}
+}
+
+static THREAD_RESULT worker_main(thread_arg arg){
+	worker_args *a=(worker_args*)arg;
+	if(a->owner)
+		pool_serve(a);
+	else
+		work(a->pool,a->worker);
+	return 0;
+}
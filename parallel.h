@@ -0,0 +1,46 @@
+/* parallel.h */
+
+/* runs a job over every tile of an image, or of every frame of a stack, on
+ * a pool of worker threads. The tiling depends only on the image and window
+ * size, never on the thread count, so a job whose tiles are independent
+ * gives the same result however many threads run it */
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#define TILE_ROWS	128	/* smallest tile height */
+#define TILE_COLS	512	/* smallest tile width */
+#define MAX_THREADS	256
+
+/* tile height for windows of wr rows, width for windows of wc columns */
+#define TILE_HEIGHT(wr)	(4*(wr)>TILE_ROWS ? 4*(wr) : TILE_ROWS)
+#define TILE_WIDTH(wc)	(4*(wc)>TILE_COLS ? 4*(wc) : TILE_COLS)
+
+/* filter output rows r0..r1-1, columns c0..c1-1 of one frame on worker
+ * 0..nworkers-1 */
+typedef void (*tile_job)(void*, int, int, int, int, int, int);
+
+/* how an output is cut into tiles and how many workers run them */
+typedef struct {
+	int no_frames, no_rows, no_cols;	/* of the part tiled */
+	int r0, c0;			/* where that part starts */
+	int tile_rows, tile_cols;	/* largest tile */
+	int tiles_across, tiles_per_frame, ntiles;
+	int nworkers;
+	const volatile int *cancel;	/* tiles left are skipped once it
+					 * is set, unless null */
+	double elapsed;			/* seconds run_tiles() took */
+	double busy[MAX_THREADS];	/* seconds each worker ran tiles */
+} tile_plan;
+
+/* worker threads kept between runs (see parallel.c), for one run at a
+ * time */
+typedef struct worker_pool worker_pool;
+
+int parallel_threads(int);
+void plan_tiles(tile_plan*, int, int, int, int, int, int, int, int);
+void run_tiles(tile_plan*, tile_job, void*, worker_pool*);
+worker_pool *pool_create(void);
+void pool_free(worker_pool*);
+
+#endif
@@ -0,0 +1,173 @@
+/* rawfilter.c */
+
+/* USAGE: rawfilter filter in.raw out.raw width height ws [nlook [damp]]
+ *							[name value ...]
+ *
+ * filters a raw image file (row after row, native byte order, the frames
+ * of a stack one after the other) with av2, med2, lee2 (which takes nlook)
+ * or elee2 (nlook and damp) of filters.h, writing out.raw the same way.
+ * ws is the side of square windows, or their width and height as WxH.
+ * Files of any size are filtered a strip of rows at a time (see stream.c),
+ * with memory for a few strips only.
+ *
+ * 'frames':	frames in in.raw (default 1)
+ * 'class':	of in.raw: 'double' (default), 'single', 'uint8', 'uint16' or
+ *		'int16'
+ * 'out':	class of out.raw, 'same' as in.raw (default) or as 'class'
+ * 'offset':	header bytes before the image (default 0)
+ * 'strip':	image rows filtered at a time (default about 32 MB of output)
+ * 'mask':	file of height rows of width bytes, only the pixels where it
+ *		is not 0 being filtered (in every frame), the others copied
+ * 'sigma':	of method 'gauss', S for both axes or SWxSH as ws is
+ *		(default: a third of the window's reach)
+ * 'method', 'threads', 'border':	as for the mex files
+ *
+ * With FILTER_STATS set (and not "0") the time and counters of the strips'
+ * filtering are printed to stderr (see filter_stats). */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "filters.h"
+
+static void usage(void);
+static void fail(const char*, const char*);
+static unsigned char *read_mask(const char*, size_t);
+
+int main(int argc, char **argv){
+	const char *name, *value;
+	int nargs, i, width, height, ws, nlook=0, damp=0, rc;
+	filter_options opts;
+	filter_files files;
+	filter_stats stats;
+	char text[512], *end;
+
+	if(argc<7)
+		usage();
+	if(!strcmp(argv[1],"av2") || !strcmp(argv[1],"med2"))
+		nargs=0;
+	else if(!strcmp(argv[1],"lee2"))
+		nargs=1;
+	else if(!strcmp(argv[1],"elee2"))
+		nargs=2;
+	else
+		fail(filter_message(FILTER_ERR_FILTER),"");
+	if(argc<7+nargs || (argc-7-nargs)%2!=0)
+		usage();
+	width=atoi(argv[4]);
+	height=atoi(argv[5]);
+	ws=atoi(argv[6]);
+	if(nargs>0)
+		nlook=atoi(argv[7]);
+	if(nargs>1)
+		damp=atoi(argv[8]);
+
+	/* an image of height rows of width values is, to the filters, the
+	 * column-major width x height matrix (see filters.h), a strip of its
+	 * rows a strip of columns and a window WxH a window of W rows and H
+	 * columns */
+	filter_defaults(&opts);
+	if((end=strchr(argv[6],'x'))){
+		opts.window[0]=ws;
+		opts.window[1]=atoi(end+1);
+	}
+	files.in=argv[2];
+	files.out=argv[3];
+	files.offset=0;
+	files.in_class=FILTER_DOUBLE;
+	files.out_class=FILTER_SAME;
+	files.no_rows=width;
+	files.no_cols=height;
+	files.no_frames=1;
+	files.strip=0;
+	for(i=7+nargs; i<argc; i+=2){
+		name=argv[i];
+		value=argv[i+1];
+		if(!strcmp(name,"frames"))
+			files.no_frames=atoi(value);
+		else if(!strcmp(name,"class")){
+			files.in_class=filter_class_named(value);
+			if(files.in_class<=FILTER_SAME)
+				fail("unknown class ",value);
+		}
+		else if(!strcmp(name,"out")){
+			files.out_class=filter_class_named(value);
+			if(files.out_class<0)
+				fail("unknown class ",value);
+		}
+		else if(!strcmp(name,"offset"))
+			files.offset=strtoll(value,0,10);
+		else if(!strcmp(name,"strip"))
+			files.strip=atoi(value);
+		else if(!strcmp(name,"mask"))
+			opts.mask=read_mask(value,(size_t)width*height);
+		else if(!strcmp(name,"method")){
+			strncpy(opts.method,value,sizeof(opts.method)-1);
+			opts.method[sizeof(opts.method)-1]=0;
+		}
+		else if(!strcmp(name,"threads"))
+			opts.threads=atoi(value);
+		else if(!strcmp(name,"sigma")){
+			/* along image rows and columns, as windows WxH */
+			opts.sigma[0]=opts.sigma[1]=strtod(value,&end);
+			if(*end=='x')
+				opts.sigma[1]=strtod(end+1,&end);
+			if(end==value || *end || !(opts.sigma[0]>=0)
+			    || !(opts.sigma[1]>=0))
+				fail("'sigma' must be S or SWxSH, not negative: ",
+									value);
+		}
+		else if(!strcmp(name,"border")){
+			/* a policy name, or a number to pad with */
+			opts.border_value=strtod(value,&end);
+			if(end!=value && !*end)
+				opts.border=BORDER_CONSTANT;
+			else if((opts.border=filter_border_named(value))<0)
+				fail(filter_message(FILTER_ERR_BORDER),"");
+		}
+		else
+			fail("unknown option ",name);
+	}
+
+	value=getenv("FILTER_STATS");
+	if(value && value[0] && strcmp(value,"0")){
+		memset(&stats,0,sizeof(stats));
+		opts.stats=&stats;
+	}
+	rc=filter_stream(argv[1],&files,ws,nlook,damp,&opts);
+	if(rc==FILTER_OK && opts.stats){
+		filter_stats_text(&stats,text,sizeof(text));
+		fprintf(stderr,"rawfilter: %s\n",text);
+	}
+	if(rc==FILTER_ERR_FILE)
+		fail("cannot map in.raw or write out.raw, or in.raw does not "
+			"hold width x height x frames of its class: ",argv[2]);
+	if(rc!=FILTER_OK)
+		fail(filter_message(rc),"");
+	return 0;
+}
+
+static void usage(void){
+	fprintf(stderr,"usage: rawfilter av2|med2|lee2|elee2 in.raw out.raw width height ws|WxH\n"
+		"\t\t[nlook [damp]] [frames|class|out|offset|strip|mask|method|sigma\n"
+		"\t\t|threads|border value ...]\n");
+	exit(2);
+}
+
+/* the bytes bytes of the file at path */
+static unsigned char *read_mask(const char *path, size_t bytes){
+	unsigned char *mask;
+	FILE *f;
+
+	mask = (unsigned char*) malloc (bytes+1);
+	f=fopen(path,"rb");
+	if(!mask || !f || fread(mask,1,bytes,f)!=bytes)
+		fail("cannot read width x height bytes of the mask ",path);
+	fclose(f);
+	return mask;
+}
+
+static void fail(const char *message, const char *what){
+	fprintf(stderr,"rawfilter: %s%s\n",message,what);
+	exit(1);
+}
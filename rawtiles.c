@@ -0,0 +1,468 @@
+/* rawtiles.c */
+
+/* USAGE: rawtiles split filter in.raw width height ws [nlook [damp]] dir
+ *							[name value ...]
+ *	  rawtiles run dir/manifest k [threads n]
+ *	  rawtiles join dir/manifest out.raw
+ *
+ * filters a raw image file (as rawfilter does) in tiles that separate
+ * processes, on one machine or many sharing dir, can run in any order:
+ *
+ * 'split' cuts in.raw into tiles, each with the halo of input its windows
+ * read, into dir/tile_K.in, writes dir/manifest (the filter, its arguments
+ * and the tiles) and prints the number of tiles.
+ * 'run' filters tile k (0 .. tiles-1) into dir/tile_K.out.
+ * 'join' puts the tile outputs together into out.raw.
+ *
+ * The result is rawfilter's to the bit: tiles are cut on multiples of the
+ * filters' own tile size (parallel.h), so every worker splits its tile as a
+ * single call splits the image, and carry a halo where the image goes on
+ * (and, for 'wrap', past its edges from the far side), other edges being
+ * padded by the worker as a single call pads them. Nodes should blend with
+ * the same vector unit (FILTER_ISA, see README.md) for lee2 and elee2.
+ *
+ * 'tile':	WxH, the largest tile, rounded up to the filters' tile size
+ *		(default 4096x4096)
+ * 'frames', 'class', 'out', 'offset', 'method', 'border':	as for
+ *		rawfilter, of split */
+
+#define _FILE_OFFSET_BITS 64	/* files over 2 GB on 32-bit systems */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "filters.h"
+#include "parallel.h"
+
+#ifdef _WIN32
+#define SEEK(f,at)	_fseeki64(f,(long long)(at),SEEK_SET)
+#else
+#define SEEK(f,at)	fseeko(f,(off_t)(at),SEEK_SET)
+#endif
+
+#define MAX_TILES	65536
+
+/* one tile: output columns x0 .. x0+width-1 and rows y0 .. y0+height-1 of
+ * every frame, its input having left, top, right and bottom more */
+typedef struct {
+	int x0, y0, width, height;
+	int left, top, right, bottom;
+} tile;
+
+/* what dir/manifest holds */
+typedef struct {
+	char filter[16], method[32];
+	int win_w, win_h, nlook, damp;
+	int border;
+	double border_value;
+	int in_class, out_class;
+	int width, height, frames;
+	int ntiles;
+	tile *tiles;
+} manifest;
+
+/* prototypes */
+static int split(int, char**);
+static int run(int, char**);
+static int join(int, char**);
+static void cut_tiles(manifest*, int, int);
+static void write_manifest(const char*, const manifest*);
+static void read_manifest(const char*, manifest*);
+static void tile_path(char*, size_t, const char*, int, const char*);
+static int halo(int, int, int);
+static int wrap(int, int);
+static void usage(void);
+static void fail(const char*, const char*);
+
+int main(int argc, char **argv){
+	if(argc<2)
+		usage();
+	if(!strcmp(argv[1],"split"))
+		return split(argc,argv);
+	if(!strcmp(argv[1],"run"))
+		return run(argc,argv);
+	if(!strcmp(argv[1],"join"))
+		return join(argc,argv);
+	usage();
+	return 2;
+}
+
+/* rawtiles split ... (see above) */
+static int split(int argc, char **argv){
+	manifest m;
+	long long offset=0;
+	int nargs, i, k, f, y, x, sx, sy, n, span, tile_w=4096, tile_h=4096;
+	size_t size;
+	const char *name, *value, *dir;
+	char path[1024], *end, *out;
+	FILE *in, *file;
+	tile *t;
+
+	if(argc<8)
+		usage();
+	memset(&m,0,sizeof(m));
+	strncpy(m.filter,argv[2],sizeof(m.filter)-1);
+	if(!strcmp(m.filter,"av2") || !strcmp(m.filter,"med2"))
+		nargs=0;
+	else if(!strcmp(m.filter,"lee2"))
+		nargs=1;
+	else if(!strcmp(m.filter,"elee2"))
+		nargs=2;
+	else
+		fail(filter_message(FILTER_ERR_FILTER),"");
+	if(argc<8+nargs || (argc-8-nargs)%2!=0)
+		usage();
+	m.width=atoi(argv[4]);
+	m.height=atoi(argv[5]);
+	m.win_w=m.win_h=atoi(argv[6]);
+	if((end=strchr(argv[6],'x')))
+		m.win_h=atoi(end+1);
+	if(nargs>0)
+		m.nlook=atoi(argv[7]);
+	if(nargs>1)
+		m.damp=atoi(argv[8]);
+	dir=argv[7+nargs];
+	m.frames=1;
+	m.in_class=FILTER_DOUBLE;
+	m.out_class=FILTER_SAME;
+	m.border=BORDER_MIRROR;
+	for(i=8+nargs; i<argc; i+=2){
+		name=argv[i];
+		value=argv[i+1];
+		if(!strcmp(name,"tile")){
+			tile_w=tile_h=atoi(value);
+			if((end=strchr(value,'x')))
+				tile_h=atoi(end+1);
+		}
+		else if(!strcmp(name,"frames"))
+			m.frames=atoi(value);
+		else if(!strcmp(name,"class")){
+			m.in_class=filter_class_named(value);
+			if(m.in_class<=FILTER_SAME)
+				fail("unknown class ",value);
+		}
+		else if(!strcmp(name,"out")){
+			m.out_class=filter_class_named(value);
+			if(m.out_class<0)
+				fail("unknown class ",value);
+		}
+		else if(!strcmp(name,"offset"))
+			offset=strtoll(value,0,10);
+		else if(!strcmp(name,"method"))
+			strncpy(m.method,value,sizeof(m.method)-1);
+		else if(!strcmp(name,"border")){
+			/* a policy name, or a number to pad with */
+			m.border_value=strtod(value,&end);
+			if(end!=value && !*end)
+				m.border=BORDER_CONSTANT;
+			else if((m.border=filter_border_named(value))<0)
+				fail(filter_message(FILTER_ERR_BORDER),"");
+		}
+		else
+			fail("unknown option ",name);
+	}
+	if(m.out_class==FILTER_SAME)
+		m.out_class=m.in_class;
+	if(m.win_w<1 || m.win_h<1)
+		fail(filter_message(FILTER_ERR_WINDOW),"");
+	if(m.width<1 || m.height<1 || m.frames<1 || tile_w<1 || tile_h<1)
+		fail(filter_message(FILTER_ERR_SIZE),"");
+	cut_tiles(&m,tile_w,tile_h);
+
+	/* a tile at a time, reading just its columns of each row (in runs
+	 * not crossing the image's sides, for wrapped halos), so that two
+	 * files are open whatever the number of tiles */
+	size=filter_class_size(m.in_class);
+	in=fopen(argv[3],"rb");
+	if(!in)
+		fail("cannot read ",argv[3]);
+	out = (char*) malloc ((size_t)(m.tiles[0].width+m.tiles[0].left
+				+m.tiles[0].right+2*m.win_w)*size+1);
+	if(!out)
+		fail(filter_message(FILTER_ERR_MEMORY),"");
+	for(k=0; k<m.ntiles; k++){
+		t=&m.tiles[k];
+		tile_path(path,sizeof(path),dir,k,"in");
+		if(!(file=fopen(path,"wb")))
+			fail("cannot write ",path);
+		n=t->left+t->width+t->right;
+		for(f=0; f<m.frames; f++)
+		for(y=t->y0-t->top; y<t->y0+t->height+t->bottom; y++){
+			sy=wrap(y,m.height);
+			for(x=0; x<n; x+=span){
+				sx=wrap(t->x0-t->left+x,m.width);
+				span=n-x<m.width-sx ? n-x : m.width-sx;
+				if(SEEK(in,offset+(((long long)f*m.height+sy)
+					*m.width+sx)*(long long)size)!=0
+				    || fread(out+(size_t)x*size,size,span,in)
+							!=(size_t)span)
+					fail("in.raw does not hold width x height x frames of its class: ",
+								argv[3]);
+			}
+			if(fwrite(out,size,n,file)!=(size_t)n)
+				fail("cannot write ",path);
+		}
+		if(fclose(file)!=0)
+			fail("cannot write ",path);
+	}
+	fclose(in);
+	free(out);
+
+	snprintf(path,sizeof(path),"%s/manifest",dir);
+	write_manifest(path,&m);
+	printf("%d\n",m.ntiles);
+	free(m.tiles);
+	return 0;
+}
+
+/* rawtiles run ... (see above) */
+static int run(int argc, char **argv){
+	manifest m;
+	filter_options opts;
+	filter_data d;
+	tile *t;
+	int k, rc;
+	size_t n, in_size, out_size;
+	char dir[1024], path[1040], done[1024], *slash;
+	void *in, *out;
+	FILE *f;
+
+	if(argc!=4 && !(argc==6 && !strcmp(argv[4],"threads")))
+		usage();
+	read_manifest(argv[2],&m);
+	k=atoi(argv[3]);
+	if(k<0 || k>=m.ntiles)
+		fail("no such tile in ",argv[2]);
+	t=&m.tiles[k];
+	strncpy(dir,argv[2],sizeof(dir)-1);
+	dir[sizeof(dir)-1]=0;
+	slash=strrchr(dir,'/');
+	if(slash)
+		*slash=0;
+	else
+		strcpy(dir,".");
+
+	/* the tile with its halo is the column-major matrix of its width
+	 * and height (see rawfilter.c), the tile itself a region of it */
+	filter_defaults(&opts);
+	strcpy(opts.method,m.method);
+	opts.border=m.border;
+	opts.border_value=m.border_value;
+	opts.window[0]=m.win_w;
+	opts.window[1]=m.win_h;
+	opts.region[0]=t->left;
+	opts.region[1]=t->left+t->width;
+	opts.region[2]=t->top;
+	opts.region[3]=t->top+t->height;
+	if(argc==6)
+		opts.threads=atoi(argv[5]);
+	d.in_class=m.in_class;
+	d.out_class=m.out_class;
+	d.no_rows=t->left+t->width+t->right;
+	d.no_cols=t->top+t->height+t->bottom;
+	d.no_frames=m.frames;
+	n=(size_t)d.no_rows*d.no_cols*d.no_frames;
+	in_size=n*filter_class_size(m.in_class);
+	out_size=(size_t)t->width*t->height*m.frames
+					*filter_class_size(m.out_class);
+	in=malloc(in_size+1);
+	out=malloc(out_size+1);
+	if(!in || !out)
+		fail(filter_message(FILTER_ERR_MEMORY),"");
+	tile_path(path,sizeof(path),dir,k,"in");
+	f=fopen(path,"rb");
+	if(!f || fread(in,1,in_size,f)!=in_size)
+		fail("cannot read ",path);
+	fclose(f);
+	d.in=in;
+	d.out=out;
+	rc=filter_run(m.filter,&d,m.win_w,m.nlook,m.damp,&opts);
+	if(rc!=FILTER_OK)
+		fail(filter_message(rc),"");
+
+	/* written under another name first, so that join never reads part
+	 * of a tile */
+	tile_path(done,sizeof(done),dir,k,"out");
+	snprintf(path,sizeof(path),"%s.part",done);
+	f=fopen(path,"wb");
+	if(!f || fwrite(out,1,out_size,f)!=out_size || fclose(f)!=0
+	    || rename(path,done)!=0)
+		fail("cannot write ",done);
+	free(in);
+	free(out);
+	free(m.tiles);
+	return 0;
+}
+
+/* rawtiles join ... (see above) */
+static int join(int argc, char **argv){
+	manifest m;
+	tile *t;
+	int k, f, y;
+	size_t size;
+	char dir[1024], path[1024], *slash, *row;
+	FILE *in, *out;
+
+	if(argc!=4)
+		usage();
+	read_manifest(argv[2],&m);
+	strncpy(dir,argv[2],sizeof(dir)-1);
+	dir[sizeof(dir)-1]=0;
+	slash=strrchr(dir,'/');
+	if(slash)
+		*slash=0;
+	else
+		strcpy(dir,".");
+	size=filter_class_size(m.out_class);
+	row = (char*) malloc ((size_t)m.tiles[0].width*size+1);
+	out=fopen(argv[3],"wb");
+	if(!row || !out)
+		fail("cannot write ",argv[3]);
+	for(k=0; k<m.ntiles; k++){
+		t=&m.tiles[k];
+		tile_path(path,sizeof(path),dir,k,"out");
+		in=fopen(path,"rb");
+		if(!in)
+			fail("tile not run yet: ",path);
+		for(f=0; f<m.frames; f++)
+		for(y=t->y0; y<t->y0+t->height; y++){
+			if(fread(row,size,t->width,in)!=(size_t)t->width)
+				fail("tile cut short: ",path);
+			if(SEEK(out,(((long long)f*m.height+y)*m.width+t->x0)
+							*(long long)size)!=0
+			    || fwrite(row,size,t->width,out)!=(size_t)t->width)
+				fail("cannot write ",argv[3]);
+		}
+		fclose(in);
+	}
+	if(fclose(out)!=0)
+		fail("cannot write ",argv[3]);
+	free(row);
+	free(m.tiles);
+	return 0;
+}
+
+/* cut m's image into tiles of up to tile_w x tile_h, row of tiles after
+ * row of tiles, on multiples of the filters' own tiles */
+static void cut_tiles(manifest *m, int tile_w, int tile_h){
+	int x, y, k, step_w, step_h, pad_w, pad_h, wrapped;
+	tile *t;
+
+	/* image rows are filter rows (see rawfilter.c) */
+	step_w=TILE_WIDTH(m->win_w);
+	step_h=TILE_HEIGHT(m->win_h);
+	tile_w=(tile_w+step_w-1)/step_w*step_w;
+	tile_h=(tile_h+step_h-1)/step_h*step_h;
+	pad_w=m->win_w/2;
+	pad_h=m->win_h/2;
+	wrapped=m->border==BORDER_WRAP;
+	m->ntiles=((m->width+tile_w-1)/tile_w)*((m->height+tile_h-1)/tile_h);
+	if(m->ntiles>MAX_TILES)
+		fail("too many tiles, use a larger 'tile'","");
+	m->tiles = (tile*) malloc (m->ntiles*sizeof(tile));
+	if(!m->tiles)
+		fail(filter_message(FILTER_ERR_MEMORY),"");
+	k=0;
+	for(y=0; y<m->height; y+=tile_h)
+	for(x=0; x<m->width; x+=tile_w){
+		t=&m->tiles[k++];
+		t->x0=x;
+		t->y0=y;
+		t->width=x+tile_w<m->width ? tile_w : m->width-x;
+		t->height=y+tile_h<m->height ? tile_h : m->height-y;
+		t->left=halo(pad_w,x,wrapped);
+		t->top=halo(pad_h,y,wrapped);
+		t->right=halo(pad_w,m->width-x-t->width,wrapped);
+		t->bottom=halo(pad_h,m->height-y-t->height,wrapped);
+	}
+}
+
+/* the halo of pad pixels on a side with left more pixels of the image,
+ * up to the image edge unless wrapped */
+static int halo(int pad, int left, int wrapped){
+	return wrapped || pad<left ? pad : left;
+}
+
+static void write_manifest(const char *path, const manifest *m){
+	const tile *t;
+	FILE *f;
+	int k;
+
+	f=fopen(path,"w");
+	if(!f)
+		fail("cannot write ",path);
+	fprintf(f,"rawtiles 1\n");
+	fprintf(f,"filter %s %d %d %d %d\n",m->filter,m->win_w,m->win_h,
+							m->nlook,m->damp);
+	fprintf(f,"method %s\n",m->method[0] ? m->method : "-");
+	fprintf(f,"border %d %.17g\n",m->border,m->border_value);
+	fprintf(f,"image %d %d %d %d %d\n",m->width,m->height,m->frames,
+						m->in_class,m->out_class);
+	fprintf(f,"tiles %d\n",m->ntiles);
+	for(k=0; k<m->ntiles; k++){
+		t=&m->tiles[k];
+		fprintf(f,"%d %d %d %d %d %d %d %d\n",t->x0,t->y0,t->width,
+			t->height,t->left,t->top,t->right,t->bottom);
+	}
+	if(fclose(f)!=0)
+		fail("cannot write ",path);
+}
+
+static void read_manifest(const char *path, manifest *m){
+	tile *t;
+	FILE *f;
+	int k, version=0, ok;
+
+	memset(m,0,sizeof(manifest));
+	f=fopen(path,"r");
+	if(!f)
+		fail("cannot read ",path);
+	ok=fscanf(f,"rawtiles %d",&version)==1 && version==1
+	    && fscanf(f," filter %15s %d %d %d %d",m->filter,&m->win_w,
+				&m->win_h,&m->nlook,&m->damp)==5
+	    && fscanf(f," method %31s",m->method)==1
+	    && fscanf(f," border %d %lf",&m->border,&m->border_value)==2
+	    && fscanf(f," image %d %d %d %d %d",&m->width,&m->height,
+			&m->frames,&m->in_class,&m->out_class)==5
+	    && fscanf(f," tiles %d",&m->ntiles)==1
+	    && m->ntiles>0 && m->ntiles<=MAX_TILES
+	    && filter_class_size(m->in_class) && filter_class_size(m->out_class);
+	if(ok && !(m->tiles = (tile*) malloc (m->ntiles*sizeof(tile))))
+		fail(filter_message(FILTER_ERR_MEMORY),"");
+	for(k=0; ok && k<m->ntiles; k++){
+		t=&m->tiles[k];
+		ok=fscanf(f,"%d %d %d %d %d %d %d %d",&t->x0,&t->y0,&t->width,
+			&t->height,&t->left,&t->top,&t->right,&t->bottom)==8;
+	}
+	fclose(f);
+	if(!ok)
+		fail("not a rawtiles manifest: ",path);
+	if(!strcmp(m->method,"-"))
+		m->method[0]=0;
+}
+
+/* dir/tile_K.ext */
+static void tile_path(char *path, size_t n, const char *dir, int k,
+							const char *ext){
+	snprintf(path,n,"%s/tile_%d.%s",dir,k,ext);
+}
+
+/* pos within 0..n-1 as BORDER_WRAP has it, halos reaching past the image
+ * only with that border */
+static int wrap(int pos, int n){
+	return (pos%n+n)%n;
+}
+
+static void usage(void){
+	fprintf(stderr,"usage: rawtiles split av2|med2|lee2|elee2 in.raw width height ws|WxH\n"
+		"\t\t[nlook [damp]] dir [tile|frames|class|out|offset|method|border\n"
+		"\t\tvalue ...]\n"
+		"       rawtiles run dir/manifest k [threads n]\n"
+		"       rawtiles join dir/manifest out.raw\n");
+	exit(2);
+}
+
+static void fail(const char *message, const char *what){
+	fprintf(stderr,"rawtiles: %s%s\n",message,what);
+	exit(1);
+}
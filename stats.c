@@ -0,0 +1,91 @@
+/* stats.c */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include "stats.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+static const char *phase_names[FILTER_PHASES]={
+	"args", "setup", "scratch", "filter", "finish"
+};
+
+/* seconds from a fixed point, for differences */
+double stats_clock(void){
+#ifdef _WIN32
+	LARGE_INTEGER count, rate;
+
+	QueryPerformanceCounter(&count);
+	QueryPerformanceFrequency(&rate);
+	return (double)count.QuadPart/rate.QuadPart;
+#else
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC,&t);
+	return t.tv_sec+1e-9*t.tv_nsec;
+#endif
+}
+
+/* start timing the first phase of a pass from now */
+void stats_start(filter_stats *stats, double *since){
+	if(stats)
+		*since=stats_clock();
+}
+
+/* the time since *since goes to phase, the next phase starting now */
+void stats_phase(filter_stats *stats, int phase, double *since){
+	double now;
+
+	if(!stats)
+		return;
+	now=stats_clock();
+	stats->seconds[phase]+=now-*since;
+	*since=now;
+}
+
+/* a pass has run plan with bytes of tables and scratch, the filter and
+ * engine it ran being printf() of format and what follows */
+void stats_pass(filter_stats *stats, const tile_plan *plan, size_t bytes,
+						const char *format, ...){
+	va_list args;
+	int w;
+
+	if(!stats)
+		return;
+	stats->pixels+=(double)plan->no_rows*plan->no_cols*plan->no_frames;
+	stats->bytes+=bytes;
+	stats->tiles+=plan->ntiles;
+	stats->threads=plan->nworkers;
+	stats->available+=plan->nworkers*plan->elapsed;
+	for(w=0; w<plan->nworkers; w++)
+		stats->busy+=plan->busy[w];
+	va_start(args,format);
+	vsnprintf(stats->path,sizeof(stats->path),format,args);
+	va_end(args);
+}
+
+/* stats as one line of text in buf, of n bytes */
+void filter_stats_text(const filter_stats *stats, char *buf, size_t n){
+	double total=0;
+	size_t len;
+	int p;
+
+	for(p=0; p<FILTER_PHASES; p++)
+		total+=stats->seconds[p];
+	len=snprintf(buf,n,"%.3f ms (",1e3*total);
+	for(p=0; p<FILTER_PHASES && len<n; p++)
+		len+=snprintf(buf+len,n-len,"%s%s %.3f",p ? ", " : "",
+					phase_names[p],1e3*stats->seconds[p]);
+	if(len<n)
+		snprintf(buf+len,n-len,"), %.1f Mpixel/s, %.1f MB, %d threads "
+			"%.0f%% busy, %d tiles, %s",
+			total>0 ? stats->pixels/total/1e6 : 0,stats->bytes/1048576,
+			stats->threads,stats->available>0
+				? 100*stats->busy/stats->available : 0,
+			stats->tiles,stats->path);
+}
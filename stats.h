@@ -0,0 +1,23 @@
+/* stats.h */
+
+/* filling in the filter_stats of filters.h a phase at a time. Every call
+ * does nothing when the stats pointer is null, so calls not asking for them
+ * read no clocks beyond the few run_tiles() takes */
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <stddef.h>
+#include "filters.h"
+#include "parallel.h"
+
+/* what stats_pass() paths say of inputs staged a tile at a time (see
+ * typed.h) */
+#define STATS_STAGED(typed)	((typed) ? " staged" : "")
+
+double stats_clock(void);
+void stats_start(filter_stats*, double*);
+void stats_phase(filter_stats*, int, double*);
+void stats_pass(filter_stats*, const tile_plan*, size_t, const char*, ...);
+
+#endif
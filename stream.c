@@ -0,0 +1,314 @@
+/* stream.c */
+
+/* filtering of raw files larger than memory. The input file is mapped, not
+ * read, and filtered a strip of columns (rows of a row-major image file) at
+ * a time through the 'region' option, the windows at the edges of a strip
+ * reading its neighbours straight from the mapping. Strips start on
+ * multiples of the tile height, so each is tiled as in a call on the whole
+ * image and the output is the same to the bit.
+ *
+ * While one strip is filtered the previous one is written out by a second
+ * thread and the system is asked to read ahead the input of the next one,
+ * and the pages of input no later strip reads are dropped from the mapping:
+ * memory stays at two output strips and about two strips of input, however
+ * large the file. The strips share one filter_cache (the caller's, or one
+ * of the call's own), so the worker threads and scratch are set up once */
+
+#define _FILE_OFFSET_BITS 64	/* files over 2 GB on 32-bit systems */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "filters.h"
+#include "frames.h"
+#include "parallel.h"
+#include "threads.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define STRIP_BYTES	(32<<20)	/* output strip when not set */
+
+#define ADVISE_NEED	0		/* read ahead */
+#define ADVISE_DROP	1		/* no longer needed */
+
+/* a whole file mapped read only */
+typedef struct {
+	const char *data;
+	size_t bytes;
+#ifdef _WIN32
+	HANDLE file, mapping;
+#else
+	int fd;
+#endif
+} file_map;
+
+/* one strip on its way to the output file */
+typedef struct {
+	FILE *f;
+	const void *data;
+	size_t bytes;
+	int failed;
+} strip_write;
+
+/* prototypes */
+static int map_file(file_map*, const char*);
+static void unmap_file(file_map*);
+static void advise(file_map*, size_t, size_t, int);
+static THREAD_RESULT write_main(thread_arg);
+
+/* run the filter called name on files->in into files->out, a strip at a
+ * time (see above). The input must hold exactly the data files describes
+ * after its header */
+int filter_stream(const char *name, const filter_files *files, int ws,
+			int nlook, int damp, const filter_options *opts){
+	filter_options strip_opts;
+	filter_cache *own;		/* strip_opts.cache when made here */
+	filter_data d;
+	file_map in;
+	strip_write pending;
+	thread_t writer;
+	FILE *out;
+	char *bufs[2];
+	int f, c0, c1, strip, height, pad, n, writing=0, rc=FILTER_OK;
+	int win_rows, win_cols;
+	size_t col_in, col_out, frame_in, base, dropped;
+	double total;
+
+	if(!opts){
+		filter_defaults(&strip_opts);
+		opts=&strip_opts;
+	}
+	if(strcmp(name,"av2") && strcmp(name,"med2") && strcmp(name,"lee2")
+	    && strcmp(name,"elee2"))
+		return FILTER_ERR_FILTER;
+	rc=frames_window(ws,opts,&win_rows,&win_cols);
+	if(rc!=FILTER_OK)
+		return rc;
+	if(opts->iterations>1)
+		return FILTER_ERR_ITERATE;	/* a pass needs all of the last */
+	if(opts->previous)
+		return FILTER_ERR_PREVIOUS;	/* laid out as a whole matrix */
+	if(files->no_rows<0 || files->no_cols<0 || files->no_frames<0
+	    || files->offset<0)
+		return FILTER_ERR_SIZE;
+	d.in_class=files->in_class;
+	d.out_class=files->out_class==FILTER_SAME ? files->in_class
+							: files->out_class;
+	if(!filter_class_size(d.in_class) || !filter_class_size(d.out_class))
+		return FILTER_ERR_CLASS;
+	d.no_rows=files->no_rows;
+	d.no_cols=files->no_cols;
+	d.no_frames=1;
+
+	col_in=(size_t)d.no_rows*filter_class_size(d.in_class);
+	col_out=(size_t)d.no_rows*filter_class_size(d.out_class);
+	frame_in=col_in*d.no_cols;
+	total=(double)files->offset+(double)frame_in*files->no_frames;
+	if(total>(double)(size_t)-1)
+		return FILTER_ERR_MEMORY;	/* cannot be mapped at all */
+
+	/* whole tiles per strip (see above) */
+	height=TILE_HEIGHT(win_rows);
+	strip=files->strip;
+	if(strip<=0)
+		strip=col_out ? (int)(STRIP_BYTES/col_out/height)*height : 0;
+	strip=strip<height ? height : (strip+height-1)/height*height;
+	if(strip>d.no_cols)
+		strip=d.no_cols>0 ? d.no_cols : 1;
+	pad=win_rows/2;
+
+	rc=map_file(&in,files->in);
+	if(rc!=FILTER_OK)
+		return rc;
+	if((double)in.bytes!=total){
+		unmap_file(&in);
+		return FILTER_ERR_FILE;
+	}
+	out=fopen(files->out,"wb");
+	if(!out){
+		unmap_file(&in);
+		return FILTER_ERR_FILE;
+	}
+	bufs[0] = (char*) malloc ((size_t)strip*col_out+1);
+	bufs[1] = (char*) malloc ((size_t)strip*col_out+1);
+	if(!bufs[0] || !bufs[1])
+		rc=FILTER_ERR_MEMORY;
+
+	strip_opts=*opts;
+	strip_opts.region[0]=0;
+	strip_opts.region[1]=d.no_rows;
+	own=0;
+	if(!strip_opts.cache)
+		strip_opts.cache=own=filter_cache_create();
+	n=0;
+	for(f=0; f<files->no_frames && rc==FILTER_OK; f++){
+		base=(size_t)files->offset+f*frame_in;
+		d.in=in.data+base;
+		dropped=0;
+		for(c0=0; c0<d.no_cols && rc==FILTER_OK; c0=c1){
+			c1=c0+strip<d.no_cols ? c0+strip : d.no_cols;
+			if(c1<d.no_cols)
+				advise(&in,base+c1*col_in,
+					(c1+strip+pad<d.no_cols ? strip+pad
+						: d.no_cols-c1)*col_in,
+					ADVISE_NEED);
+
+			d.out=bufs[n%2];
+			strip_opts.region[2]=c0;
+			strip_opts.region[3]=c1;
+			rc=filter_run(name,&d,ws,nlook,damp,&strip_opts);
+
+			/* the strip before is written while this one runs */
+			if(writing){
+				THREAD_JOIN(writer);
+				writing=0;
+				if(pending.failed && rc==FILTER_OK)
+					rc=FILTER_ERR_FILE;
+			}
+			if(rc!=FILTER_OK)
+				break;
+			pending.f=out;
+			pending.data=d.out;
+			pending.bytes=(c1-c0)*col_out;
+			pending.failed=0;
+			/* on a thread of its own, else here */
+			if(THREAD_START(&writer,write_main,&pending))
+				writing=1;
+			else{
+				write_main(&pending);
+				if(pending.failed)
+					rc=FILTER_ERR_FILE;
+			}
+			n++;
+
+			/* columns before c1-pad are read by no later strip of
+			 * this frame (a wrapped border reads them again from
+			 * the file) */
+			if(c1-pad>0 && (size_t)(c1-pad)*col_in>dropped){
+				advise(&in,base+dropped,
+					(c1-pad)*col_in-dropped,ADVISE_DROP);
+				dropped=(c1-pad)*col_in;
+			}
+		}
+	}
+	if(writing){
+		THREAD_JOIN(writer);
+		if(pending.failed && rc==FILTER_OK)
+			rc=FILTER_ERR_FILE;
+	}
+	if(fclose(out)!=0 && rc==FILTER_OK)
+		rc=FILTER_ERR_FILE;
+	filter_cache_free(own);
+	free(bufs[0]);
+	free(bufs[1]);
+	unmap_file(&in);
+	return rc;
+}
+
+/* map the file at path, returning FILTER_OK or FILTER_ERR_FILE */
+static int map_file(file_map *m, const char *path){
+#ifdef _WIN32
+	LARGE_INTEGER size;
+
+	m->data=0;
+	m->bytes=0;
+	m->mapping=0;
+	m->file=CreateFileA(path,GENERIC_READ,FILE_SHARE_READ,0,OPEN_EXISTING,
+					FILE_FLAG_SEQUENTIAL_SCAN,0);
+	if(m->file==INVALID_HANDLE_VALUE)
+		return FILTER_ERR_FILE;
+	if(!GetFileSizeEx(m->file,&size)
+	    || (unsigned long long)size.QuadPart>(size_t)-1){
+		CloseHandle(m->file);
+		return FILTER_ERR_FILE;
+	}
+	m->bytes=(size_t)size.QuadPart;
+	if(m->bytes==0)
+		return FILTER_OK;
+	m->mapping=CreateFileMappingA(m->file,0,PAGE_READONLY,0,0,0);
+	if(m->mapping)
+		m->data=(const char*)MapViewOfFile(m->mapping,FILE_MAP_READ,0,0,0);
+	if(!m->data){
+		unmap_file(m);
+		return FILTER_ERR_FILE;
+	}
+	return FILTER_OK;
+#else
+	struct stat st;
+	void *p;
+
+	m->data=0;
+	m->bytes=0;
+	m->fd=open(path,O_RDONLY);
+	if(m->fd<0)
+		return FILTER_ERR_FILE;
+	if(fstat(m->fd,&st)!=0 || (unsigned long long)st.st_size>(size_t)-1){
+		close(m->fd);
+		return FILTER_ERR_FILE;
+	}
+	m->bytes=(size_t)st.st_size;
+	if(m->bytes==0)
+		return FILTER_OK;
+	p=mmap(0,m->bytes,PROT_READ,MAP_SHARED,m->fd,0);
+	if(p==MAP_FAILED){
+		close(m->fd);
+		return FILTER_ERR_FILE;
+	}
+	m->data=(const char*)p;
+	return FILTER_OK;
+#endif
+}
+
+static void unmap_file(file_map *m){
+#ifdef _WIN32
+	if(m->data)
+		UnmapViewOfFile(m->data);
+	if(m->mapping)
+		CloseHandle(m->mapping);
+	CloseHandle(m->file);
+#else
+	if(m->data)
+		munmap((void*)m->data,m->bytes);
+	close(m->fd);
+#endif
+	m->data=0;
+}
+
+/* tell the system bytes at offset at of m are about to be read, or will not
+ * be read again (pages that only partly hold them are left alone). Windows
+ * decides this by itself */
+static void advise(file_map *m, size_t at, size_t bytes, int what){
+#ifndef _WIN32
+	size_t page, from, to;
+
+	page=(size_t)sysconf(_SC_PAGESIZE);
+	if(!m->data || !bytes || page==0)
+		return;
+	if(what==ADVISE_NEED){
+		from=at/page*page;
+		to=at+bytes;
+		posix_madvise((void*)(m->data+from),to-from,POSIX_MADV_WILLNEED);
+		return;
+	}
+	from=(at+page-1)/page*page;
+	to=(at+bytes)/page*page;
+#ifdef MADV_DONTNEED
+	if(to>from)
+		madvise((void*)(m->data+from),to-from,MADV_DONTNEED);
+#endif
+#endif
+}
+
+/* write the strip_write arg */
+static THREAD_RESULT write_main(thread_arg arg){
+	strip_write *w=(strip_write*)arg;
+	w->failed=fwrite(w->data,1,w->bytes,w->f)!=w->bytes;
+	return 0;
+}
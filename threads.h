@@ -0,0 +1,60 @@
+/* threads.h */
+
+/* the locks, condition variables and threads of parallel.c, async.c and
+ * stream.c, on Windows or POSIX threads. A static_lock_t (with a cond_t of
+ * COND_STATIC_INIT) needs no LOCK_INIT, for state of the whole library. A
+ * thread runs a function declared static THREAD_RESULT fn(thread_arg),
+ * returning 0 */
+
+#ifndef THREADS_H
+#define THREADS_H
+
+#ifdef _WIN32
+#include <windows.h>
+typedef CRITICAL_SECTION lock_t;
+typedef CONDITION_VARIABLE cond_t;
+typedef HANDLE thread_t;
+typedef LPVOID thread_arg;
+#define THREAD_RESULT	DWORD WINAPI
+#define THREAD_START(t,fn,arg)	((*(t)=CreateThread(0,0,fn,arg,0,0))!=0)
+#define THREAD_JOIN(t)	(WaitForSingleObject(t,INFINITE), CloseHandle(t))
+#define LOCK_INIT(l)	InitializeCriticalSection(l)
+#define LOCK(l)		EnterCriticalSection(l)
+#define UNLOCK(l)	LeaveCriticalSection(l)
+#define LOCK_FREE(l)	DeleteCriticalSection(l)
+#define COND_INIT(c)	InitializeConditionVariable(c)
+#define WAIT(c,l)	SleepConditionVariableCS(c,l,INFINITE)
+#define WAKE_ALL(c)	WakeAllConditionVariable(c)
+#define COND_FREE(c)
+typedef SRWLOCK static_lock_t;
+#define STATIC_LOCK_INIT	SRWLOCK_INIT
+#define COND_STATIC_INIT	CONDITION_VARIABLE_INIT
+#define STATIC_LOCK(l)	AcquireSRWLockExclusive(l)
+#define STATIC_UNLOCK(l)	ReleaseSRWLockExclusive(l)
+#define STATIC_WAIT(c,l)	SleepConditionVariableSRW(c,l,INFINITE,0)
+#else
+#include <pthread.h>
+typedef pthread_mutex_t lock_t;
+typedef pthread_cond_t cond_t;
+typedef pthread_t thread_t;
+typedef void *thread_arg;
+#define THREAD_RESULT	void*
+#define THREAD_START(t,fn,arg)	(pthread_create(t,0,fn,arg)==0)
+#define THREAD_JOIN(t)	pthread_join(t,0)
+#define LOCK_INIT(l)	pthread_mutex_init(l,0)
+#define LOCK(l)		pthread_mutex_lock(l)
+#define UNLOCK(l)	pthread_mutex_unlock(l)
+#define LOCK_FREE(l)	pthread_mutex_destroy(l)
+#define COND_INIT(c)	pthread_cond_init(c,0)
+#define WAIT(c,l)	pthread_cond_wait(c,l)
+#define WAKE_ALL(c)	pthread_cond_broadcast(c)
+#define COND_FREE(c)	pthread_cond_destroy(c)
+typedef pthread_mutex_t static_lock_t;
+#define STATIC_LOCK_INIT	PTHREAD_MUTEX_INITIALIZER
+#define COND_STATIC_INIT	PTHREAD_COND_INITIALIZER
+#define STATIC_LOCK(l)	pthread_mutex_lock(l)
+#define STATIC_UNLOCK(l)	pthread_mutex_unlock(l)
+#define STATIC_WAIT(c,l)	pthread_cond_wait(c,l)
+#endif
+
+#endif
@@ -0,0 +1,274 @@
+/* typed.c */
+
+#include <math.h>
+#include <string.h>
+#include "typed.h"
+
+/* prototypes */
+static void load_row(typed_image*, int, const int*, int, int, double, double*);
+static void put_element(void*, int, size_t, double);
+static double saturate(double, double, double);
+
+/* arena space typed_load() takes for a tile of up to tile_rows x tile_cols
+ * and windows of win_rows x win_cols */
+size_t typed_scratch(int tile_rows, int tile_cols, int win_rows, int win_cols){
+	size_t height, width;
+
+	height=tile_rows+2*(win_rows/2);
+	width=tile_cols+2*(win_cols/2);
+	return ARENA_BYTES(height*width*sizeof(double))
+		+ARENA_BYTES(height*sizeof(double*))
+		+ARENA_BYTES(width*sizeof(int))
+		+ARENA_BYTES((size_t)tile_rows*tile_cols*sizeof(double))
+		+ARENA_BYTES(tile_rows*sizeof(double*));
+}
+
+/* convert output rows r0..r1-1, columns c0..c1-1 of frame f of img and the
+ * padding around them (as pad describes it) to double in arena space */
+void typed_load(typed_image *img, border *pad, typed_tile *t, int frame,
+			int r0, int r1, int c0, int c1, arena *scratch){
+	int r, c, rp, cp, nr, nc, width, src;
+	double *block;
+
+	rp=pad->row_pad;
+	cp=pad->col_pad;
+	nr=r1-r0;
+	nc=c1-c0;
+	width=nc+2*cp;
+	t->no_rows=nr;
+	t->no_cols=nc;
+	t->frame=frame;
+	t->r0=r0;
+	t->c0=c0;
+
+	/* the tile with its padding, laid out as border.h does BORDER_CONSTANT */
+	memset(&t->in,0,sizeof(border));
+	t->in.no_rows=nr;
+	t->in.no_cols=nc;
+	t->in.row_pad=rp;
+	t->in.col_pad=cp;
+	t->in.policy=pad->policy;
+	t->in.value=pad->value;
+	block = (double*) arena_alloc (scratch,(size_t)(nr+2*rp)*width*sizeof(double));
+	t->in.rows = (double**) arena_alloc (scratch,(nr+2*rp)*sizeof(double*));
+	t->in.cols = (int*) arena_alloc (scratch,width*sizeof(int));
+	t->in.rows+=rp;
+	t->in.cols+=cp;
+	for(c=-cp; c<nc+cp; c++)
+		t->in.cols[c]=c;
+	for(r=-rp; r<nr+rp; r++){
+		t->in.rows[r]=block+(size_t)(r+rp)*width+cp;
+		src=pad->rowmap[r0+r];
+		if(src>=0)
+			src+=frame*img->no_rows;
+		load_row(img,src,pad->colmap+c0,-cp,nc+cp,pad->value,t->in.rows[r]);
+	}
+
+	block = (double*) arena_alloc (scratch,(size_t)nr*nc*sizeof(double));
+	t->out = (double**) arena_alloc (scratch,nr*sizeof(double*));
+	for(r=0; r<nr; r++)
+		t->out[r]=block+(size_t)r*nc;
+}
+
+/* convert the filtered tile to the output class, rounding and saturating
+ * as MATLAB does */
+void typed_store(typed_image *img, typed_tile *t){
+	size_t at;
+	int r, c, nc;
+	double *src;
+
+	nc=t->no_cols;
+	for(r=0; r<t->no_rows; r++){
+		src=t->out[r];
+		at=((size_t)t->frame*img->out_rows+t->r0+r-img->out_r0)
+					*img->out_cols+t->c0-img->out_c0;
+		switch(img->out_class){
+		case FILTER_SINGLE:
+			for(c=0; c<nc; c++)
+				((float*)img->out)[at+c]=(float)src[c];
+			break;
+		case FILTER_UINT8:
+			for(c=0; c<nc; c++)
+				((unsigned char*)img->out)[at+c]=
+					(unsigned char)saturate(src[c],0,255);
+			break;
+		case FILTER_UINT16:
+			for(c=0; c<nc; c++)
+				((unsigned short*)img->out)[at+c]=
+					(unsigned short)saturate(src[c],0,65535);
+			break;
+		case FILTER_INT16:
+			for(c=0; c<nc; c++)
+				((short*)img->out)[at+c]=
+					(short)saturate(src[c],-32768,32767);
+			break;
+		default:
+			memcpy((double*)img->out+at,src,nc*sizeof(double));
+		}
+	}
+}
+
+/* copy the input to the output in row r of frame, columns c0..c1-1, where
+ * mask (laid out as a frame of the input) is 0, converting as typed_store()
+ * does */
+void typed_pass(typed_image *img, const unsigned char *mask, int frame, int r,
+							int c0, int c1){
+	size_t in_at, out_at, size;
+	int c, end;
+
+	in_at=((size_t)frame*img->no_rows+r)*img->no_cols;
+	out_at=((size_t)frame*img->out_rows+r-img->out_r0)*img->out_cols
+								-img->out_c0;
+	mask+=(size_t)r*img->no_cols;
+	if(img->in_class==img->out_class){
+		/* a run of unselected pixels at a time */
+		size=filter_class_size(img->in_class);
+		for(c=c0; c<c1; c=end){
+			for(; c<c1 && mask[c]; c++)
+				;
+			for(end=c; end<c1 && !mask[end]; end++)
+				;
+			memcpy((char*)img->out+(out_at+c)*size,
+				(const char*)img->in+(in_at+c)*size,(end-c)*size);
+		}
+		return;
+	}
+	for(c=c0; c<c1; c++)
+		if(!mask[c])
+			put_element(img->out,img->out_class,out_at+c,
+			    typed_element(img->in,img->in_class,in_at+c));
+}
+
+/* as typed_pass(), the pixels mask does not select being copied from kept,
+ * an earlier output laid out as img->out and of its class */
+void typed_keep(typed_image *img, const void *kept, const unsigned char *mask,
+					int frame, int r, int c0, int c1){
+	size_t out_at, size;
+	int c, end;
+
+	out_at=((size_t)frame*img->out_rows+r-img->out_r0)*img->out_cols
+								-img->out_c0;
+	mask+=(size_t)r*img->no_cols;
+	size=filter_class_size(img->out_class);
+	for(c=c0; c<c1; c=end){
+		for(; c<c1 && mask[c]; c++)
+			;
+		for(end=c; end<c1 && !mask[end]; end++)
+			;
+		memcpy((char*)img->out+(out_at+c)*size,
+			(const char*)kept+(out_at+c)*size,(end-c)*size);
+	}
+}
+
+/* element i of data of a FILTER_ class, as a double */
+double typed_element(const void *data, int cls, size_t i){
+	switch(cls){
+	case FILTER_SINGLE:	return ((const float*)data)[i];
+	case FILTER_UINT8:	return ((const unsigned char*)data)[i];
+	case FILTER_UINT16:	return ((const unsigned short*)data)[i];
+	case FILTER_INT16:	return ((const short*)data)[i];
+	}
+	return ((const double*)data)[i];
+}
+
+/* smallest and largest value of the input rows rowmap[r0..r1-1] of every
+ * frame (those a window can read, see border.h), returning 0 (and leaving
+ * them unset) when there are none or they hold non-integers, NaN or Inf */
+int typed_range(typed_image *img, const int *rowmap, int r0, int r1,
+						double *mn, double *mx){
+	size_t i, n, at;
+	int f, r, any=0;
+	double x, lo=0, hi=0;
+
+	n=img->no_cols;
+	if(n==0)
+		return 0;
+
+#define RANGE(type) { \
+	const type *p=(const type*)img->in+at; \
+	if(!any) \
+		lo=hi=p[0]; \
+	for(i=0; i<n; i++){ \
+		x=p[i]; \
+		if(x!=floor(x) || x-x!=0)	/* NaN, Inf */ \
+			return 0; \
+		if(x<lo) lo=x; \
+		if(x>hi) hi=x; \
+	} \
+	}
+	for(f=0; f<img->no_frames; f++)
+	for(r=r0; r<r1; r++){
+		if(rowmap[r]<0)
+			continue;
+		at=((size_t)f*img->no_rows+rowmap[r])*n;
+		switch(img->in_class){
+		case FILTER_SINGLE:	RANGE(float); break;
+		case FILTER_UINT8:	RANGE(unsigned char); break;
+		case FILTER_UINT16:	RANGE(unsigned short); break;
+		case FILTER_INT16:	RANGE(short); break;
+		default:		RANGE(double);
+		}
+		any=1;
+	}
+#undef RANGE
+	if(!any)
+		return 0;
+	*mn=lo;
+	*mx=hi;
+	return 1;
+}
+
+/* dst[from..to-1] from input row src, counted across frames (the padding
+ * value when src or the column is -1) */
+static void load_row(typed_image *img, int src, const int *colmap, int from,
+					int to, double value, double *dst){
+	int c;
+
+	if(src<0){
+		for(c=from; c<to; c++)
+			dst[c]=value;
+		return;
+	}
+
+#define LOAD(type) { \
+	const type *p=(const type*)img->in+(size_t)src*img->no_cols; \
+	for(c=from; c<to; c++) \
+		dst[c]=colmap[c]<0 ? value : (double)p[colmap[c]]; \
+	}
+	switch(img->in_class){
+	case FILTER_SINGLE:	LOAD(float); break;
+	case FILTER_UINT8:	LOAD(unsigned char); break;
+	case FILTER_UINT16:	LOAD(unsigned short); break;
+	case FILTER_INT16:	LOAD(short); break;
+	default:		LOAD(double);
+	}
+#undef LOAD
+}
+
+/* set element i of data of a FILTER_ class to x, as typed_store() does */
+static void put_element(void *data, int cls, size_t i, double x){
+	switch(cls){
+	case FILTER_SINGLE:
+		((float*)data)[i]=(float)x;
+		break;
+	case FILTER_UINT8:
+		((unsigned char*)data)[i]=(unsigned char)saturate(x,0,255);
+		break;
+	case FILTER_UINT16:
+		((unsigned short*)data)[i]=(unsigned short)saturate(x,0,65535);
+		break;
+	case FILTER_INT16:
+		((short*)data)[i]=(short)saturate(x,-32768,32767);
+		break;
+	default:
+		((double*)data)[i]=x;
+	}
+}
+
+/* x rounded half away from zero and clamped to lo..hi, NaN giving 0 */
+static double saturate(double x, double lo, double hi){
+	if(x!=x)
+		return 0;
+	x=round(x);
+	return x<lo ? lo : x>hi ? hi : x;
+}
@@ -0,0 +1,46 @@
+/* typed.h */
+
+/* inputs and outputs of classes other than double. The engines work in
+ * double, so each worker converts the rows and columns one tile needs (with
+ * its padding) into its arena, filters that, and converts the result into
+ * the output as it goes: nothing the size of the image is ever held in
+ * double. Safe to use from worker threads */
+
+#ifndef TYPED_H
+#define TYPED_H
+
+#include "arena.h"
+#include "border.h"
+#include "filters.h"
+
+/* a matrix or stack as the filters see it, filter row r (MATLAB
+ * column r) of frame f starting at element (f*no_rows+r)*no_cols */
+typedef struct {
+	int in_class, out_class;	/* FILTER_ classes */
+	const void *in;
+	void *out;
+	int no_rows, no_cols, no_frames;
+	int out_r0, out_c0, out_rows, out_cols;	/* the block of each frame
+						 * out holds */
+} typed_image;
+
+/* one tile in double: a no_rows x no_cols image with its padding already in
+ * place, filtered as output rows 0..no_rows-1, columns 0..no_cols-1 */
+typedef struct {
+	border in;
+	double **out;
+	int no_rows, no_cols;
+	int frame, r0, c0;	/* where the tile sits in the image */
+} typed_tile;
+
+size_t typed_scratch(int, int, int, int);
+void typed_load(typed_image*, border*, typed_tile*, int, int, int, int, int,
+								arena*);
+void typed_store(typed_image*, typed_tile*);
+void typed_pass(typed_image*, const unsigned char*, int, int, int, int);
+void typed_keep(typed_image*, const void*, const unsigned char*, int, int,
+								int, int);
+double typed_element(const void*, int, size_t);
+int typed_range(typed_image*, const int*, int, int, double*, double*);
+
+#endif
@@ -0,0 +1,343 @@
+/* weights.c */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "weights.h"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define WEIGHTS_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define ISA_TARGET(isa)				/* no flags needed */
+#else
+#define ISA_TARGET(isa)	__attribute__((target(isa)))
+#endif
+#endif
+
+/* the vector paths must round exactly as the scalar one, so no multiply and
+ * add may be fused into an FMA (which AVX-512 would otherwise allow) */
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC optimize("fp-contract=off")
+#else
+#pragma STDC FP_CONTRACT OFF
+#endif
+
+/* exp() range reduction: rounding to an integer by adding and removing
+ * 1.5*2^52, ln2 split so n*EXP_LN2_HI is exact */
+#define EXP_ROUND	6755399441055744.0
+#define EXP_LN2_HI	6.93147180369123816490e-01
+#define EXP_LN2_LO	1.90821492927058770002e-10
+
+static const char *isa_names[]={"scalar","sse2","avx2","avx512"};
+
+/* blend the centre value Ic with the local mean Im given the local variance */
+double lee_weight(double Ic, double Im, double var, int nlook){
+	double S, Ci, Cu, W;
+	S=sqrt(var);
+	Ci=S/Im;
+	Cu=sqrt(1.0/nlook);
+	W=1.0-(pow(Cu,2)/pow(Ci,2));
+	return (Ic*W)+(Im*(1.0-W));
+}
+
+/* blend the centre value Ic with the local mean Im given the local variance */
+double elee_weight(double Ic, double Im, double var, int nlook, int damp){
+	double S, Cmax, Ci, Cu, W;
+	S=sqrt(var);
+	Cmax=sqrt(1.0+2.0/nlook);
+	Ci=S/Im;
+	Cu=sqrt(1.0/nlook);
+	W=exp( (-1.0*damp)*(Ci-Cu)/(Cmax-Ci) );
+	if(Ci <= Cu) return Im;
+	else if(Ci >= Cmax) return Ic;
+	else return (Im*W)+(Ic*(1.0-W));
+}
+
+#ifdef WEIGHTS_X86
+
+/* SSE2 */
+#define VW		2
+#define VD		__m128d
+#define VM		__m128d
+#define VFN(name)	name##_sse2
+#define V_TARGET	ISA_TARGET("sse2")
+#define V_LOAD(p)	_mm_loadu_pd(p)
+#define V_STORE(p,v)	_mm_storeu_pd(p,v)
+#define V_SET1(x)	_mm_set1_pd(x)
+#define V_ADD(a,b)	_mm_add_pd(a,b)
+#define V_SUB(a,b)	_mm_sub_pd(a,b)
+#define V_MUL(a,b)	_mm_mul_pd(a,b)
+#define V_DIV(a,b)	_mm_div_pd(a,b)
+#define V_SQRT(a)	_mm_sqrt_pd(a)
+#define V_MIN(a,b)	_mm_min_pd(a,b)
+#define V_MAX(a,b)	_mm_max_pd(a,b)
+#define V_LE(a,b)	_mm_cmple_pd(a,b)
+#define V_GE(a,b)	_mm_cmpge_pd(a,b)
+#define V_NAN(a)	_mm_cmpunord_pd(a,a)
+#define V_SEL(m,a,b)	_mm_or_pd(_mm_and_pd(m,a),_mm_andnot_pd(m,b))
+#define V_POW2(k)	_mm_castsi128_pd(_mm_slli_epi64(_mm_add_epi64( \
+			_mm_castpd_si128(_mm_add_pd(k,_mm_set1_pd(EXP_ROUND))), \
+			_mm_set1_epi64x(1023)),52))
+#include "weights_kernel.h"
+#undef VW
+#undef VD
+#undef VM
+#undef VFN
+#undef V_TARGET
+#undef V_LOAD
+#undef V_STORE
+#undef V_SET1
+#undef V_ADD
+#undef V_SUB
+#undef V_MUL
+#undef V_DIV
+#undef V_SQRT
+#undef V_MIN
+#undef V_MAX
+#undef V_LE
+#undef V_GE
+#undef V_NAN
+#undef V_SEL
+#undef V_POW2
+
+/* AVX2 */
+#define VW		4
+#define VD		__m256d
+#define VM		__m256d
+#define VFN(name)	name##_avx2
+#define V_TARGET	ISA_TARGET("avx2")
+#define V_LOAD(p)	_mm256_loadu_pd(p)
+#define V_STORE(p,v)	_mm256_storeu_pd(p,v)
+#define V_SET1(x)	_mm256_set1_pd(x)
+#define V_ADD(a,b)	_mm256_add_pd(a,b)
+#define V_SUB(a,b)	_mm256_sub_pd(a,b)
+#define V_MUL(a,b)	_mm256_mul_pd(a,b)
+#define V_DIV(a,b)	_mm256_div_pd(a,b)
+#define V_SQRT(a)	_mm256_sqrt_pd(a)
+#define V_MIN(a,b)	_mm256_min_pd(a,b)
+#define V_MAX(a,b)	_mm256_max_pd(a,b)
+#define V_LE(a,b)	_mm256_cmp_pd(a,b,_CMP_LE_OQ)
+#define V_GE(a,b)	_mm256_cmp_pd(a,b,_CMP_GE_OQ)
+#define V_NAN(a)	_mm256_cmp_pd(a,a,_CMP_UNORD_Q)
+#define V_SEL(m,a,b)	_mm256_blendv_pd(b,a,m)
+#define V_POW2(k)	_mm256_castsi256_pd(_mm256_slli_epi64(_mm256_add_epi64( \
+			_mm256_castpd_si256(_mm256_add_pd(k,_mm256_set1_pd(EXP_ROUND))), \
+			_mm256_set1_epi64x(1023)),52))
+#include "weights_kernel.h"
+#undef VW
+#undef VD
+#undef VM
+#undef VFN
+#undef V_TARGET
+#undef V_LOAD
+#undef V_STORE
+#undef V_SET1
+#undef V_ADD
+#undef V_SUB
+#undef V_MUL
+#undef V_DIV
+#undef V_SQRT
+#undef V_MIN
+#undef V_MAX
+#undef V_LE
+#undef V_GE
+#undef V_NAN
+#undef V_SEL
+#undef V_POW2
+
+/* AVX-512 (foundation instructions only) */
+#define VW		8
+#define VD		__m512d
+#define VM		__mmask8
+#define VFN(name)	name##_avx512
+#define V_TARGET	ISA_TARGET("avx512f")
+#define V_LOAD(p)	_mm512_loadu_pd(p)
+#define V_STORE(p,v)	_mm512_storeu_pd(p,v)
+#define V_SET1(x)	_mm512_set1_pd(x)
+#define V_ADD(a,b)	_mm512_add_pd(a,b)
+#define V_SUB(a,b)	_mm512_sub_pd(a,b)
+#define V_MUL(a,b)	_mm512_mul_pd(a,b)
+#define V_DIV(a,b)	_mm512_div_pd(a,b)
+#define V_SQRT(a)	_mm512_sqrt_pd(a)
+#define V_MIN(a,b)	_mm512_min_pd(a,b)
+#define V_MAX(a,b)	_mm512_max_pd(a,b)
+#define V_LE(a,b)	_mm512_cmp_pd_mask(a,b,_CMP_LE_OQ)
+#define V_GE(a,b)	_mm512_cmp_pd_mask(a,b,_CMP_GE_OQ)
+#define V_NAN(a)	_mm512_cmp_pd_mask(a,a,_CMP_UNORD_Q)
+#define V_SEL(m,a,b)	_mm512_mask_blend_pd(m,b,a)
+#define V_POW2(k)	_mm512_castsi512_pd(_mm512_slli_epi64(_mm512_add_epi64( \
+			_mm512_castpd_si512(_mm512_add_pd(k,_mm512_set1_pd(EXP_ROUND))), \
+			_mm512_set1_epi64(1023)),52))
+#include "weights_kernel.h"
+
+/* instruction sets the processor and operating system support */
+static int cpu_isa(void){
+#ifdef _MSC_VER
+	int info[4];
+	unsigned long long xcr0;
+
+	__cpuid(info,1);
+	if(!(info[3] & (1<<26)))
+		return WEIGHTS_SCALAR;
+	if(!(info[2] & (1<<27)) || !(info[2] & (1<<28)))	/* OSXSAVE, AVX */
+		return WEIGHTS_SSE2;
+	xcr0=_xgetbv(0);
+	if((xcr0 & 6)!=6)
+		return WEIGHTS_SSE2;
+	__cpuidex(info,7,0);
+	if(!(info[1] & (1<<5)))
+		return WEIGHTS_SSE2;
+	if(!(info[1] & (1<<16)) || (xcr0 & 0xe6)!=0xe6)
+		return WEIGHTS_AVX2;
+	return WEIGHTS_AVX512;
+#else
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("avx512f"))
+		return WEIGHTS_AVX512;
+	if(__builtin_cpu_supports("avx2"))
+		return WEIGHTS_AVX2;
+	if(__builtin_cpu_supports("sse2"))
+		return WEIGHTS_SSE2;
+	return WEIGHTS_SCALAR;
+#endif
+}
+
+#else
+
+static int cpu_isa(void){
+	return WEIGHTS_SCALAR;
+}
+
+#endif
+
+/* widest instruction set this processor runs, capped by the FILTER_ISA
+ * environment variable ("scalar", "sse2", "avx2" or "avx512") */
+int weights_isa(void){
+	const char *env;
+	int isa, i;
+
+	isa=cpu_isa();
+	env=getenv("FILTER_ISA");
+	if(env){
+		for(i=WEIGHTS_SCALAR; i<=WEIGHTS_AVX512; i++){
+			if(!strcmp(env,isa_names[i]) && i<isa)
+				isa=i;
+		}
+	}
+	return isa;
+}
+
+const char *weights_isa_name(int isa){
+	return isa_names[isa];
+}
+
+/* lee_weight() of n adjacent pixels with instruction set isa */
+void lee_weights(int isa, const double *Ic, const double *Im,
+			const double *var, double *out, int n, int nlook){
+	int i;
+
+#ifdef WEIGHTS_X86
+	if(isa==WEIGHTS_AVX512){
+		lee_weights_avx512(Ic,Im,var,out,n,nlook);
+		return;
+	}
+	if(isa==WEIGHTS_AVX2){
+		lee_weights_avx2(Ic,Im,var,out,n,nlook);
+		return;
+	}
+	if(isa==WEIGHTS_SSE2){
+		lee_weights_sse2(Ic,Im,var,out,n,nlook);
+		return;
+	}
+#endif
+	for(i=0; i<n; i++)
+		out[i]=lee_weight(Ic[i],Im[i],var[i],nlook);
+}
+
+/* elee_weight() of n adjacent pixels with instruction set isa */
+void elee_weights(int isa, const double *Ic, const double *Im,
+		const double *var, double *out, int n, int nlook, int damp){
+	int i;
+
+#ifdef WEIGHTS_X86
+	if(isa==WEIGHTS_AVX512){
+		elee_weights_avx512(Ic,Im,var,out,n,nlook,damp);
+		return;
+	}
+	if(isa==WEIGHTS_AVX2){
+		elee_weights_avx2(Ic,Im,var,out,n,nlook,damp);
+		return;
+	}
+	if(isa==WEIGHTS_SSE2){
+		elee_weights_sse2(Ic,Im,var,out,n,nlook,damp);
+		return;
+	}
+#endif
+	for(i=0; i<n; i++)
+		out[i]=elee_weight(Ic[i],Im[i],var[i],nlook,damp);
+}
+
+/* difference between a and the reference b in ulp of the largest of b, Ic
+ * and Im (infinite when only one of a and b is NaN or infinite) */
+static double ulps(double a, double b, double Ic, double Im){
+	double scale;
+	int e;
+
+	if(a==b || (a!=a && b!=b))
+		return 0;
+	if(a!=a || b!=b || fabs(a-b)>=HUGE_VAL)
+		return HUGE_VAL;
+	scale=fabs(b);
+	if(fabs(Ic)>scale) scale=fabs(Ic);
+	if(fabs(Im)>scale) scale=fabs(Im);
+	frexp(scale,&e);
+	return fabs(a-b)/ldexp(1.0,e-53);
+}
+
+/* largest difference, in the units of WEIGHTS_MAX_ULP, between instruction
+ * set isa (no wider than weights_isa()) and the scalar reference, over a
+ * sweep of looks, damping and coefficients of variation from well below Cu
+ * to well above Cmax, plus the zero, infinite and NaN statistics of flat or
+ * broken windows. bench runs it for every instruction set in use */
+double weights_check(int isa){
+	double Ic[512], Im[512], var[512], out[512], worst, u, cv;
+	unsigned int seed;
+	int nlook, damp, i, n;
+
+	worst=0;
+	seed=12345;
+	for(nlook=1; nlook<=16; nlook++){
+		for(damp=0; damp<=8; damp++){
+			n=496+nlook;		/* leaves a partial vector */
+			for(i=0; i<n; i++){
+				seed=seed*1103515245+12345;
+				u=(seed>>8)/16777216.0;
+				Im[i]=ldexp(1.0+u,(int)(seed%40)-20);
+				seed=seed*1103515245+12345;
+				u=(seed>>8)/16777216.0;
+				cv=u*2.5*sqrt(1.0+2.0/nlook);
+				var[i]=(cv*Im[i])*(cv*Im[i]);
+				seed=seed*1103515245+12345;
+				u=(seed>>8)/16777216.0;
+				Ic[i]=Im[i]*(0.25+2.0*u);
+			}
+			Im[0]=0; var[1]=0; Im[2]=-1.0; var[3]=HUGE_VAL;
+			Im[4]=Ic[4]=var[4]=HUGE_VAL-HUGE_VAL;
+			lee_weights(isa,Ic,Im,var,out,n,nlook);
+			for(i=0; i<n; i++){
+				u=ulps(out[i],lee_weight(Ic[i],Im[i],var[i],nlook),
+								Ic[i],Im[i]);
+				if(u>worst) worst=u;
+			}
+			elee_weights(isa,Ic,Im,var,out,n,nlook,damp);
+			for(i=0; i<n; i++){
+				u=ulps(out[i],elee_weight(Ic[i],Im[i],var[i],nlook,damp),
+								Ic[i],Im[i]);
+				if(u>worst) worst=u;
+			}
+		}
+	}
+	return worst;
+}
@@ -0,0 +1,32 @@
+/* weights.h */
+
+/* the Lee and enhanced Lee blend of a centre value with its local mean given
+ * the local variance. lee_weight() and elee_weight() are the scalar
+ * reference, lee_weights() and elee_weights() blend a whole row at once with
+ * the widest vector unit the processor has. Safe to use from worker threads */
+
+#ifndef WEIGHTS_H
+#define WEIGHTS_H
+
+#define WEIGHTS_SCALAR	0
+#define WEIGHTS_SSE2	1
+#define WEIGHTS_AVX2	2
+#define WEIGHTS_AVX512	3
+
+/* largest difference from the scalar reference weights_check() allows, in
+ * units in the last place of the largest of the result, Ic and Im.
+ * lee_weights() matches the reference exactly, elee_weights() (damp >= 0)
+ * differs only by the rounding of its vector exp() */
+#define WEIGHTS_MAX_ULP	4
+
+int weights_isa(void);
+const char *weights_isa_name(int);
+double lee_weight(double, double, double, int);
+double elee_weight(double, double, double, int, int);
+void lee_weights(int, const double*, const double*, const double*, double*,
+								int, int);
+void elee_weights(int, const double*, const double*, const double*, double*,
+							int, int, int);
+double weights_check(int);
+
+#endif
@@ -0,0 +1,117 @@
+/* weights_kernel.h */
+
+/* the vector lee_weights() and elee_weights(), included by weights.c once per
+ * instruction set with these defined:
+ *
+ *	VW		lanes per vector
+ *	VD, VM		vector and comparison mask types
+ *	VFN(name)	name with the instruction set appended
+ *	V_TARGET	what the compiler needs to emit the instructions
+ *	V_LOAD, V_STORE, V_SET1, V_ADD, V_SUB, V_MUL, V_DIV, V_SQRT,
+ *	V_MIN, V_MAX	the arithmetic
+ *	V_LE, V_GE, V_NAN	comparisons giving a VM
+ *	V_SEL(m,a,b)	a where m is set, else b
+ *	V_POW2(k)	2^k for integer valued k in -1022..1023
+ *
+ * The arithmetic follows the scalar reference operation for operation, and
+ * nothing is fused, so only the exp() of the enhanced Lee can differ. Rows
+ * are blended VW pixels at a time, the last few through a full vector of
+ * copies so every pixel gets the same arithmetic */
+
+/* exp(x): x=n*ln2+r with |r|<=ln2/2, exp(r) from its Taylor series to r^13
+ * (truncation below 2^-55), 2^n applied in two halves so the subnormal and
+ * overflowing ends need no special cases */
+static V_TARGET VD VFN(exp)(VD x){
+	VD n, n1, r, p, t;
+	VM nan;
+
+	nan=V_NAN(x);
+	t=V_MAX(V_MIN(x,V_SET1(710.0)),V_SET1(-746.0));
+	n=V_SUB(V_ADD(V_MUL(t,V_SET1(1.4426950408889634)),V_SET1(EXP_ROUND)),
+							V_SET1(EXP_ROUND));
+	r=V_SUB(t,V_MUL(n,V_SET1(EXP_LN2_HI)));
+	r=V_SUB(r,V_MUL(n,V_SET1(EXP_LN2_LO)));
+
+	p=V_SET1(1.0/6227020800.0);
+	p=V_ADD(V_MUL(p,r),V_SET1(1.0/479001600.0));
+	p=V_ADD(V_MUL(p,r),V_SET1(1.0/39916800.0));
+	p=V_ADD(V_MUL(p,r),V_SET1(1.0/3628800.0));
+	p=V_ADD(V_MUL(p,r),V_SET1(1.0/362880.0));
+	p=V_ADD(V_MUL(p,r),V_SET1(1.0/40320.0));
+	p=V_ADD(V_MUL(p,r),V_SET1(1.0/5040.0));
+	p=V_ADD(V_MUL(p,r),V_SET1(1.0/720.0));
+	p=V_ADD(V_MUL(p,r),V_SET1(1.0/120.0));
+	p=V_ADD(V_MUL(p,r),V_SET1(1.0/24.0));
+	p=V_ADD(V_MUL(p,r),V_SET1(1.0/6.0));
+	p=V_ADD(V_MUL(p,r),V_SET1(0.5));
+	p=V_ADD(V_MUL(p,r),V_SET1(1.0));
+	p=V_ADD(V_MUL(p,r),V_SET1(1.0));
+
+	n1=V_SUB(V_ADD(V_MUL(n,V_SET1(0.5)),V_SET1(EXP_ROUND)),V_SET1(EXP_ROUND));
+	p=V_MUL(V_MUL(p,V_POW2(n1)),V_POW2(V_SUB(n,n1)));
+	return V_SEL(nan,x,p);
+}
+
+static V_TARGET VD VFN(lee)(VD Ic, VD Im, VD var, VD cu2){
+	VD Ci, W;
+
+	Ci=V_DIV(V_SQRT(var),Im);
+	W=V_SUB(V_SET1(1.0),V_DIV(cu2,V_MUL(Ci,Ci)));
+	return V_ADD(V_MUL(Ic,W),V_MUL(Im,V_SUB(V_SET1(1.0),W)));
+}
+
+static V_TARGET VD VFN(elee)(VD Ic, VD Im, VD var, VD cu, VD cmax, VD damp){
+	VD Ci, W, blend;
+
+	Ci=V_DIV(V_SQRT(var),Im);
+	W=VFN(exp)(V_DIV(V_MUL(damp,V_SUB(Ci,cu)),V_SUB(cmax,Ci)));
+	blend=V_ADD(V_MUL(Im,W),V_MUL(Ic,V_SUB(V_SET1(1.0),W)));
+	return V_SEL(V_LE(Ci,cu),Im,V_SEL(V_GE(Ci,cmax),Ic,blend));
+}
+
+static V_TARGET void VFN(lee_weights)(const double *Ic, const double *Im,
+			const double *var, double *out, int n, int nlook){
+	double cu, t[3][VW], o[VW];
+	VD cu2;
+	int i, k;
+
+	cu=sqrt(1.0/nlook);
+	cu2=V_SET1(pow(cu,2));
+	for(i=0; i+VW<=n; i+=VW)
+		V_STORE(out+i,VFN(lee)(V_LOAD(Ic+i),V_LOAD(Im+i),V_LOAD(var+i),cu2));
+	if(i<n){
+		for(k=0; k<VW; k++){
+			t[0][k]=Ic[i+(i+k<n ? k : 0)];
+			t[1][k]=Im[i+(i+k<n ? k : 0)];
+			t[2][k]=var[i+(i+k<n ? k : 0)];
+		}
+		V_STORE(o,VFN(lee)(V_LOAD(t[0]),V_LOAD(t[1]),V_LOAD(t[2]),cu2));
+		for(k=0; i+k<n; k++)
+			out[i+k]=o[k];
+	}
+}
+
+static V_TARGET void VFN(elee_weights)(const double *Ic, const double *Im,
+		const double *var, double *out, int n, int nlook, int damp){
+	double t[3][VW], o[VW];
+	VD cu, cmax, vdamp;
+	int i, k;
+
+	cu=V_SET1(sqrt(1.0/nlook));
+	cmax=V_SET1(sqrt(1.0+2.0/nlook));
+	vdamp=V_SET1(-1.0*damp);
+	for(i=0; i+VW<=n; i+=VW)
+		V_STORE(out+i,VFN(elee)(V_LOAD(Ic+i),V_LOAD(Im+i),V_LOAD(var+i),
+							cu,cmax,vdamp));
+	if(i<n){
+		for(k=0; k<VW; k++){
+			t[0][k]=Ic[i+(i+k<n ? k : 0)];
+			t[1][k]=Im[i+(i+k<n ? k : 0)];
+			t[2][k]=var[i+(i+k<n ? k : 0)];
+		}
+		V_STORE(o,VFN(elee)(V_LOAD(t[0]),V_LOAD(t[1]),V_LOAD(t[2]),
+							cu,cmax,vdamp));
+		for(k=0; i+k<n; k++)
+			out[i+k]=o[k];
+	}
+}